@@ -0,0 +1,447 @@
+/**
+    AffineLinearADMM.cpp
+    Purpose: Computes the result of the ADMM approach to the piecewise affine-linear
+             Mumford-Shah model based on a Taylor jet splitting (cf. affineLinearMS_ADMM.m)
+             Native counterpart of the MATLAB implementation for the standalone library
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+#include "Autotuner.h"
+#include "Checkpoint.h"
+#include "SolverCache.h"
+
+// Upper bound of the adapted progression of the coupling penalties
+static const double MAX_MU_NU_STEP = 2.0;
+// Adaptive schedule: the 1D partitions are still forming if more than this fraction of their jumps changed
+static const double PARTITION_ACTIVE = 0.01;
+// Adaptive schedule: max progression while the 1D partitions are still forming (a larger mu_nu_step is reduced
+// to it, larger progressions freeze the partitions early)
+static const double FORMING_MAX_STEP = 1.5;
+// Adaptive schedule: the progression is increased if the deviation decreased by less than this factor
+static const double DEVIATION_STALL = 0.8;
+// Adaptive schedule: factor of the increase of the progression
+static const double STEP_GROWTH = 1.2;
+// Step size of the multiplier updates of the Jacobi variant (relative to the coupling penalties). All directions
+// move from the same iterate, so the full step overshoots the pair residuals they correct at once: with step 1,
+// the splitting deviation oscillates and the solves take up to twice the iterations of Gauss-Seidel (e.g. 138
+// instead of 72, at 1.3 and gamma 0.05), with 0.5 the multipliers lag (43 instead of 34 on easy images). 0.75 keeps
+// the iterations within about 20% of Gauss-Seidel; there is no convergence guarantee for either scheme
+// (non-convex model), the stopping rule is the same.
+static const double JACOBI_DAMPING = 0.75;
+
+static void UpdateMultipliers(ADMMState &state, const double damping);
+static double SplittingDeviation(const ADMMState &state);
+static double PartitionChange(const vector<cube> &as, const vector<cube> &bs, const imat &dirs,
+                              vector< Mat<unsigned char> > &jumps);
+static double AdaptivePenaltyStep(const double step, const double base_step, const double partition_change,
+                                  const double deviation, const double prev_deviation);
+static double AdaptedMuNuStep(const double mu_nu_step, const double deviation, const double rate,
+                              const double split_tol, const double time_per_iter, const double time_left);
+
+ADMMParameters::ADMMParameters()
+{
+    gamma = 1.0;
+    nr_dirs = 4;
+    max_iter = 500;
+    mu_nu_step = 1.3;
+    split_tol = 1e-2;
+    nr_threads = 32;
+    verbose = false;
+    packed_layout = true;
+    time_budget = 0;
+    cancel = NULL;
+    jacobi = false;
+    long_stripe_length = 8192;
+    tuning_profile = NULL;
+    adaptive_penalties = false;
+    checkpoint_path = NULL;
+    checkpoint_interval = 10;
+    checkpoint_float32 = false;
+    compress_channels = false;
+    cache = NULL;
+}
+
+bool Cancellation::requested() const
+{
+    return (flag != NULL && *flag != 0) || (deadline > 0 && omp_get_wtime() >= deadline);
+}
+
+int PairIndex(const int s, const int t, const int nr_dirs)
+{
+    // Row-wise enumeration of the strict upper triangle
+    return s*nr_dirs - (s*(s+1))/2 + (t-s-1);
+}
+
+void InitADMMState(ADMMState &state, const cube &f, const int nr_dirs)
+{
+    const int nr_pairs = (nr_dirs*(nr_dirs-1))/2;
+    // The memory of a state of the same size is reused (e.g. a workspace of the solver cache)
+    const bool reuse = (state.us.size() == (size_t) nr_dirs && state.lambdas.size() == (size_t) nr_pairs &&
+                        state.us[0].n_rows == f.n_rows && state.us[0].n_cols == f.n_cols &&
+                        state.us[0].n_slices == f.n_slices);
+    state.nr_dirs = nr_dirs;
+    if (reuse) {
+        for(int s = 0; s < nr_dirs; s++) {
+            state.us[s] = f;
+            state.as[s].zeros();
+            state.bs[s].zeros();
+        }
+        for(int k = 0; k < nr_pairs; k++) {
+            state.lambdas[k].zeros();
+            state.taus[k].zeros();
+            state.rhos[k].zeros();
+        }
+    } else {
+        state.us.assign(nr_dirs,f);
+        state.as.assign(nr_dirs,zeros<cube>(f.n_rows,f.n_cols,f.n_slices));
+        state.bs.assign(nr_dirs,zeros<cube>(f.n_rows,f.n_cols,f.n_slices));
+        state.lambdas.assign(nr_pairs,zeros<cube>(f.n_rows,f.n_cols,f.n_slices));
+        state.taus.assign(nr_pairs,zeros<cube>(f.n_rows,f.n_cols,f.n_slices));
+        state.rhos.assign(nr_pairs,zeros<cube>(f.n_rows,f.n_cols,f.n_slices));
+    }
+    state.mu = 0;
+    state.nu = 0;
+    state.iteration = 0;
+    state.truncated = false;
+    state.deviation = -1;
+    state.penalty_step = 0;
+    state.jumps.clear();
+    state.mus.clear();
+    state.nus.clear();
+}
+
+uword LongStripeLength(const ADMMParameters &par, const int m, const int n)
+{
+    // Stripes that would dominate the parallel loop over stripes (longer than an equal share of
+    // the pixels per thread) are solved one after another with the parallel DP
+    if (par.long_stripe_length <= 0)
+        return 0;
+    return max((uword) par.long_stripe_length,((uword) m*n + par.nr_threads-1)/par.nr_threads);
+}
+
+int AffineLinearADMM(const cube &f, const ADMMParameters &par, ADMMState &state,
+                     cube &u, cube &a, cube &b, cube &c)
+{
+    const double start_time = omp_get_wtime();
+    Cancellation cancel;
+    cancel.deadline = (par.time_budget > 0) ? start_time + par.time_budget : 0;
+    cancel.flag = par.cancel;
+    omp_set_num_threads(par.nr_threads);
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_dirs = par.nr_dirs;
+    // Weights of directions
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(nr_dirs,dirs,omegas);
+    // Max size of 1D subproblems
+    const int max_stripe_length = max(m,n);
+    // Initial coupling penalties (a resumed state keeps its penalties)
+    if (state.iteration == 0) {
+        state.mu = 1e-3;
+        state.nu = min(450*par.gamma*state.mu,1.0);
+    }
+    // Thread count, schedule, layout and stripes of each direction (taken from the cache if there is one)
+    DirectionPlans own_plans;
+    if (par.cache == NULL)
+        CreateDirectionPlans(m,n,f.n_slices,par,own_plans);
+    const DirectionPlans &direction_plans = (par.cache != NULL) ? par.cache->directionPlans(m,n,f.n_slices,par)
+                                                                : own_plans;
+    const vector<DirectionConfig> &configs = direction_plans.configs;
+    const vector<StripePlan> &plans = direction_plans.plans;
+    GivensTable own_table;
+    GivensTable* givens = &own_table;
+    // Packed copies of the subproblem data and next iterate of the Jacobi variant, allocated once per solve
+    // (kept in the cache if there is one)
+    ScratchBuffers own_buffers;
+    ScratchBuffers &buffers = (par.cache != NULL) ? par.cache->scratchBuffers(m,n,f.n_slices,nr_dirs) : own_buffers;
+    vector<PackedData> &packed = buffers.packed;
+    if (packed.size() < (size_t) (par.jacobi ? nr_dirs : 1))
+        packed.resize(par.jacobi ? nr_dirs : 1);
+    vector<cube> &us_next = buffers.us_next;
+    vector<cube> &as_next = buffers.as_next;
+    vector<cube> &bs_next = buffers.bs_next;
+    if (par.jacobi) {
+        // Copies into buffers of the same size reuse their memory
+        us_next = state.us;
+        as_next = state.as;
+        bs_next = state.bs;
+    }
+    bool stop_bool = false;
+    state.truncated = false;
+    double mu_nu_step = par.mu_nu_step;
+    double rate = 1;
+    const int first_iteration = state.iteration;
+    // The penalty history of a state that was rewound to an earlier iteration (incremental solves) is cut there
+    if (state.mus.size() > (size_t) state.iteration) {
+        state.mus.resize(state.iteration);
+        state.nus.resize(state.iteration);
+    }
+    // Periodic checkpoints of the state at the end of an iteration, written in the background
+    CheckpointWriter checkpoint(par,f);
+    // ADMM iterations (the penalties grow in each iteration, so the data weight and the Givens rotation angles
+    // change in each iteration)
+    while (state.iteration < par.max_iter) {
+        const double mu = state.mu;
+        const double nu = state.nu;
+        // Data weight of subproblems
+        const double eta = sqrt((2+mu*nr_dirs*(nr_dirs-1))/(nu*nr_dirs*(nr_dirs-1)));
+        // Calculate recurrence coefficients for the subproblems, i.e., the Givens rotation angles
+        if (par.cache != NULL)
+            givens = &par.cache->givensAngles(max_stripe_length,eta);
+        else
+            CalcGivensAngles(max_stripe_length,eta,own_table.C_linear,own_table.S_linear,
+                             own_table.C_const,own_table.S_const);
+        // Jump penalty of univariate subproblems (gamma' after eq. (20))
+        vec gammas(nr_dirs);
+        for(int s = 0; s < nr_dirs; s++)
+            gammas(s) = (2*omegas(s)*par.gamma) / ((nr_dirs-1)*nu);
+        // Solve linewise jet problems for each direction (first line of eq. (16))
+        if (par.jacobi) {
+            // All directions at once from the previous iterate (one pool of nr_threads threads with a dynamic
+            // schedule; only the layouts of the direction configs apply)
+            if (cancel.requested() ||
+                !FusedJacobiSolver(f,state,plans,gammas,eta,givens->C_linear,givens->S_linear,
+                                   givens->C_const,givens->S_const,us_next,as_next,bs_next,packed,&cancel)) {
+                state.truncated = true;
+            } else {
+                state.us.swap(us_next);
+                state.as.swap(as_next);
+                state.bs.swap(bs_next);
+            }
+        } else {
+            // The run-time schedule of the host is restored after the directions
+            omp_sched_t host_schedule;
+            int host_chunk;
+            omp_get_schedule(&host_schedule,&host_chunk);
+            for(int s = 0; s < nr_dirs && !state.truncated; s++) {
+                omp_set_num_threads(configs[s].nr_threads);
+                omp_set_schedule(configs[s].schedule,configs[s].chunk);
+                if (cancel.requested() ||
+                    !FusedLinewiseSolver(f,state,s,plans[s],gammas(s),eta,givens->C_linear,givens->S_linear,
+                                         givens->C_const,givens->S_const,packed[0],&cancel))
+                    state.truncated = true;
+            }
+            omp_set_num_threads(par.nr_threads);
+            omp_set_schedule(host_schedule,host_chunk);
+        }
+        // An interrupted iteration keeps the multipliers, the consensus of the splitting variables is returned
+        if (state.truncated)
+            break;
+        // Update Lagrange multipliers
+        UpdateMultipliers(state,par.jacobi ? JACOBI_DAMPING : 1.0);
+        // Penalties of the iteration (if the history is complete)
+        if (state.mus.size() == (size_t) state.iteration) {
+            state.mus.push_back(mu);
+            state.nus.push_back(nu);
+        }
+        state.iteration++;
+        // Check stopping criterion (line 17 of Algorithm 1)
+        const double prev_deviation = state.deviation;
+        const double deviation = SplittingDeviation(state);
+        state.deviation = deviation;
+        stop_bool = (deviation <= par.split_tol);
+        if (stop_bool) {
+            if (par.verbose)
+                printf("\nTotal number iterations: %d\n",state.iteration);
+            break;
+        }
+        // Adapt the progression of the coupling penalties to the time budget
+        if (cancel.deadline > 0) {
+            if (prev_deviation > 0)
+                rate = 0.5*rate + 0.5*(deviation/prev_deviation);
+            const double now = omp_get_wtime();
+            const double time_per_iter = (now-start_time) / (state.iteration-first_iteration);
+            const double step = AdaptedMuNuStep(mu_nu_step,deviation,rate,par.split_tol,
+                                                time_per_iter,cancel.deadline-now);
+            if (step > mu_nu_step && par.verbose)
+                printf("\nProgression of coupling penalties increased to %.3f\n",step);
+            mu_nu_step = step;
+        }
+        // Update coupling penalties
+        if (par.adaptive_penalties) {
+            // From the coupling residual (deviation) and the change of the 1D partitions
+            const double partition_change = PartitionChange(state.as,state.bs,dirs,state.jumps);
+            state.penalty_step = AdaptivePenaltyStep(state.penalty_step,mu_nu_step,partition_change,
+                                                     deviation,prev_deviation);
+        } else {
+            state.penalty_step = mu_nu_step;
+        }
+        state.mu *= state.penalty_step;
+        state.nu *= state.penalty_step;
+        if (par.verbose) {
+            printf("*");
+            fflush(stdout);
+        }
+        if (par.checkpoint_path != NULL && par.checkpoint_interval > 0 &&
+            state.iteration % par.checkpoint_interval == 0) {
+            if (!checkpoint.submit(state) && par.verbose)
+                printf("\nCheckpoint of iteration %d skipped, the previous one is still being written\n",
+                       state.iteration);
+        }
+    }
+    // Warnings are only printed in verbose mode, the library does not write to the stdout of its host
+    if (!checkpoint.wait() && par.verbose)
+        printf("\nWarning: Checkpoint could not be written to %s\n",par.checkpoint_path);
+    if (par.verbose) {
+        if (state.truncated)
+            printf("\nWarning: Solve cut short after %d iterations\n",state.iteration);
+        else if (!stop_bool)
+            printf("\nWarning: Max number of iterations (%d) reached\n",par.max_iter);
+    }
+    // Output u,a,b,c
+    ConsensusJetField(state,u,a,b,c);
+    return state.iteration;
+}
+
+// Auxiliary functions
+
+// Performs the gradient ascents of the Lagrange multipliers (eq. (16), lines 11-15 of Algorithm 1)
+// with step sizes damping*mu and damping*nu
+static void UpdateMultipliers(ADMMState &state, const double damping)
+{
+    const int nr_dirs = state.nr_dirs;
+    const double mu = damping*state.mu;
+    const double nu = damping*state.nu;
+    for(int s = 0; s < nr_dirs; s++) {
+        for(int t = s+1; t < nr_dirs; t++) {
+            const int k = PairIndex(s,t,nr_dirs);
+            state.lambdas[k] += mu*(state.us[s]-state.us[t]);
+            state.taus[k] += nu*(state.as[s]-state.as[t]);
+            state.rhos[k] += nu*(state.bs[s]-state.bs[t]);
+        }
+    }
+}
+
+// Max relative deviation between two splitting variables
+static double MaxRelativeDeviation(const cube &x, const cube &y)
+{
+    double dev = 0;
+    const double* x_raw = x.memptr();
+    const double* y_raw = y.memptr();
+    for(uword i = 0; i < x.n_elem; i++) {
+        double d = abs(x_raw[i]-y_raw[i])/(abs(x_raw[i])+abs(y_raw[i]));
+        // NaN (0/0) is ignored as in MATLAB's max
+        if (d > dev)
+            dev = d;
+    }
+    return dev;
+}
+
+// Max relative deviation between consecutive splitting variables
+static double SplittingDeviation(const ADMMState &state)
+{
+    double dev = 0;
+    for(int s = 0; s+1 < state.nr_dirs; s += 2) {
+        dev = max(dev,MaxRelativeDeviation(state.us[s],state.us[s+1]));
+        dev = max(dev,MaxRelativeDeviation(state.as[s],state.as[s+1]));
+        dev = max(dev,MaxRelativeDeviation(state.bs[s],state.bs[s+1]));
+    }
+    return dev;
+}
+
+// Number of jump indicators (the slopes of a splitting variable differ from those of the preceding pixel on its
+// stripe in any channel) that have changed since the last call relative to the number of jumps, i.e., the change of the
+// 1D partitions; jumps keeps the indicators of each direction
+static double PartitionChange(const vector<cube> &as, const vector<cube> &bs, const imat &dirs,
+                              vector< Mat<unsigned char> > &jumps)
+{
+    const int nr_dirs = as.size();
+    const int m = as[0].n_rows;
+    const int n = as[0].n_cols;
+    const int nr_channels = as[0].n_slices;
+    const bool first = jumps.empty();
+    if (first)
+        jumps.assign(nr_dirs,zeros< Mat<unsigned char> >(m,n));
+    uword nr_changed = 0, nr_jumps = 0;
+    for(int s = 0; s < nr_dirs; s++) {
+        const int x_dir = dirs(0,s);
+        const int y_dir = dirs(1,s);
+        const cube &a_s = as[s];
+        const cube &b_s = bs[s];
+        Mat<unsigned char> &jumps_s = jumps[s];
+        #pragma omp parallel for schedule(static) reduction(+:nr_changed,nr_jumps)
+        for(int j = 0; j < n; j++) {
+            for(int i = 0; i < m; i++) {
+                const int i_prev = i-y_dir;
+                const int j_prev = j-x_dir;
+                unsigned char jump = 1;
+                if (i_prev >= 0 && i_prev < m && j_prev >= 0) {
+                    // A jump of the 1D partition changes the slopes of at least one channel
+                    jump = 0;
+                    for(int ch = 0; ch < nr_channels && !jump; ch++)
+                        jump = (a_s(i,j,ch) != a_s(i_prev,j_prev,ch) || b_s(i,j,ch) != b_s(i_prev,j_prev,ch));
+                }
+                if (jump != jumps_s(i,j))
+                    nr_changed++;
+                nr_jumps += jump;
+                jumps_s(i,j) = jump;
+            }
+        }
+    }
+    return first ? 1.0 : (double) nr_changed / max(nr_jumps,(uword) 1);
+}
+
+// Progression of the coupling penalties of the adaptive schedule: while the 1D partitions are still forming,
+// the base progression is used, but at most FORMING_MAX_STEP (larger penalties would freeze them); once the
+// partitions have settled, the progression is at least base_step and is increased while the deviation stalls,
+// up to MAX_MU_NU_STEP
+static double AdaptivePenaltyStep(const double step, const double base_step, const double partition_change,
+                                  const double deviation, const double prev_deviation)
+{
+    if (partition_change > PARTITION_ACTIVE)
+        return min(base_step,FORMING_MAX_STEP);
+    if (prev_deviation > 0 && deviation > DEVIATION_STALL*prev_deviation)
+        return min(max(step,base_step)*STEP_GROWTH,max(MAX_MU_NU_STEP,base_step));
+    return max(step,base_step);
+}
+
+// Increases the progression of the coupling penalties if the projected number of iterations to reach
+// split_tol (from the smoothed decay rate of the deviation) does not fit into the remaining time.
+// The penalties then reach the level of the projected iterations within the feasible ones.
+static double AdaptedMuNuStep(const double mu_nu_step, const double deviation, const double rate,
+                              const double split_tol, const double time_per_iter, const double time_left)
+{
+    const double feasible = floor(time_left/time_per_iter);
+    if (feasible < 1)
+        return mu_nu_step;
+    // Without decay of the deviation, the number of iterations is not projectable
+    const double projected = (rate < 1) ? log(split_tol/deviation)/log(rate) : 2*feasible;
+    if (projected <= feasible)
+        return mu_nu_step;
+    // Limit the increase per iteration, the projection is rough in the first iterations
+    const double ratio = min(projected/feasible,2.0);
+    return min(pow(mu_nu_step,ratio),max(MAX_MU_NU_STEP,mu_nu_step));
+}
+
+// Returns the means of all splitting variables
+static void SplittingMeans(const ADMMState &state, cube &u, cube &a, cube &b)
+{
+    const int nr_dirs = state.nr_dirs;
+    u.zeros();
+    a.zeros();
+    b.zeros();
+    for(int s = 0; s < nr_dirs; s++) {
+        u += state.us[s];
+        a += state.as[s];
+        b += state.bs[s];
+    }
+    u /= nr_dirs;
+    a /= nr_dirs;
+    b /= nr_dirs;
+}
+
+void ConsensusJetField(const ADMMState &state, cube &u, cube &a, cube &b, cube &c)
+{
+    SplittingMeans(state,u,a,b);
+    for(int ch = 0; ch < (int) u.n_slices; ch++) {
+        for(int j = 0; j < (int) u.n_cols; j++) {
+            for(int i = 0; i < (int) u.n_rows; i++) {
+                c(i,j,ch) = u(i,j,ch) - (j+1)*a(i,j,ch) - (i+1)*b(i,j,ch);
+            }
+        }
+    }
+}
@@ -0,0 +1,359 @@
+/**
+    Autotuner.cpp
+    Purpose: Calibrates the configuration of the stripe loops (thread count, OpenMP schedule and
+             chunk size, packed or in-place layout) per image shape, number of channels and direction
+             by timing solves of a single direction on a synthetic piecewise affine image, and keeps
+             the fastest configurations in a persistent profile that later solves read
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Autotuner.h"
+
+// Calibration solves use the coupling penalties of this iteration of the default schedule
+static const int CALIBRATION_ITERATION = 15;
+// Each configuration is timed by the fastest of this number of solves
+static const int CALIBRATION_REPETITIONS = 2;
+// A thread count that is slower than the best one by this factor ends the search over thread counts
+static const double THREAD_SEARCH_SLOWDOWN = 1.1;
+
+static const char* ScheduleName(const omp_sched_t schedule);
+static bool ParseSchedule(const char* name, omp_sched_t &schedule);
+
+TuningProfile::TuningProfile()
+{
+}
+
+const std::string &TuningProfile::getPath() const
+{
+    return path;
+}
+
+std::string TuningProfile::key(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir)
+{
+    char buffer[96];
+    snprintf(buffer,sizeof(buffer),"%d %d %d %d %d",m,n,nr_channels,x_dir,y_dir);
+    return std::string(buffer);
+}
+
+bool TuningProfile::load(const char* profile_path)
+{
+    path = profile_path;
+    entries.clear();
+    FILE* file = fopen(profile_path,"r");
+    if (file == NULL)
+        return errno == ENOENT;
+    char line[256];
+    bool valid = true;
+    while (valid && fgets(line,sizeof(line),file) != NULL) {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        int m, n, nr_channels, x_dir, y_dir, packed;
+        char schedule_name[16];
+        DirectionConfig config;
+        valid = sscanf(line,"%d %d %d %d %d %d %15s %d %d %lf",&m,&n,&nr_channels,&x_dir,&y_dir,
+                       &config.nr_threads,schedule_name,&config.chunk,&packed,&config.seconds) == 10 &&
+                ParseSchedule(schedule_name,config.schedule) && config.nr_threads > 0;
+        config.packed_layout = (packed != 0);
+        if (valid)
+            entries[key(m,n,nr_channels,x_dir,y_dir)] = config;
+    }
+    fclose(file);
+    return valid;
+}
+
+bool TuningProfile::save()
+{
+    // The profile itself is replaced by the rename, hence the lock is held on a separate file
+    const std::string lock_path = path + ".lock";
+    const int lock_fd = open(lock_path.c_str(),O_RDWR|O_CREAT,0644);
+    if (lock_fd < 0)
+        return false;
+    if (flock(lock_fd,LOCK_EX) != 0) {
+        close(lock_fd);
+        return false;
+    }
+    // Entries that were saved since the profile was loaded
+    TuningProfile current;
+    bool saved = current.load(path.c_str());
+    if (saved) {
+        for(std::map<std::string,DirectionConfig>::const_iterator it = current.entries.begin();
+            it != current.entries.end(); ++it)
+            entries[it->first] = it->second;
+        saved = write();
+    }
+    flock(lock_fd,LOCK_UN);
+    close(lock_fd);
+    return saved;
+}
+
+std::string TuningProfile::fileVersion(const char* profile_path)
+{
+    struct stat status;
+    if (stat(profile_path,&status) != 0)
+        return std::string();
+    char buffer[96];
+    snprintf(buffer,sizeof(buffer),"%lu %ld %ld.%09ld",(unsigned long) status.st_ino,(long) status.st_size,
+             (long) status.st_mtim.tv_sec,(long) status.st_mtim.tv_nsec);
+    return std::string(buffer);
+}
+
+bool TuningProfile::write() const
+{
+    char suffix[32];
+    snprintf(suffix,sizeof(suffix),".tmp%d",(int) getpid());
+    const std::string tmp_path = path + suffix;
+    FILE* file = fopen(tmp_path.c_str(),"w");
+    if (file == NULL)
+        return false;
+    fprintf(file,"# PALMS tuning profile: m n nr_channels x_dir y_dir nr_threads schedule chunk packed_layout seconds\n");
+    for(std::map<std::string,DirectionConfig>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const DirectionConfig &config = it->second;
+        fprintf(file,"%s %d %s %d %d %.6g\n",it->first.c_str(),config.nr_threads,ScheduleName(config.schedule),
+                config.chunk,(int) config.packed_layout,config.seconds);
+    }
+    if (fclose(file) != 0 || rename(tmp_path.c_str(),path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TuningProfile::lookup(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir,
+                           DirectionConfig &config) const
+{
+    std::map<std::string,DirectionConfig>::const_iterator it = entries.find(key(m,n,nr_channels,x_dir,y_dir));
+    if (it == entries.end())
+        return false;
+    config = it->second;
+    return true;
+}
+
+void TuningProfile::store(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir,
+                          const DirectionConfig &config)
+{
+    entries[key(m,n,nr_channels,x_dir,y_dir)] = config;
+}
+
+DirectionConfig DefaultDirectionConfig(const ADMMParameters &par)
+{
+    DirectionConfig config;
+    config.nr_threads = par.nr_threads;
+    config.schedule = omp_sched_dynamic;
+    config.chunk = 1;
+    config.packed_layout = par.packed_layout;
+    config.seconds = 0;
+    return config;
+}
+
+// Synthetic piecewise affine image: cells of random size (16 to 128 pixels) with random affine
+// functions per channel and uniform noise
+static void SyntheticImage(const int m, const int n, const int nr_channels, cube &f)
+{
+    unsigned int seed = 12345;
+    f.set_size(m,n,nr_channels);
+    int j_0 = 0;
+    while (j_0 < n) {
+        seed = seed*1103515245 + 12345;
+        const int j_1 = min(n,j_0 + 16 + (int) ((seed >> 8) % 113));
+        int i_0 = 0;
+        while (i_0 < m) {
+            seed = seed*1103515245 + 12345;
+            const int i_1 = min(m,i_0 + 16 + (int) ((seed >> 8) % 113));
+            for(int ch = 0; ch < nr_channels; ch++) {
+                seed = seed*1103515245 + 12345;
+                const double offset = ((seed >> 8) % 1000) / 1000.0;
+                const double slope_x = (((seed >> 4) % 200) / 100.0 - 1) / (j_1-j_0);
+                const double slope_y = (((seed >> 12) % 200) / 100.0 - 1) / (i_1-i_0);
+                for(int j = j_0; j < j_1; j++) {
+                    for(int i = i_0; i < i_1; i++) {
+                        seed = seed*1103515245 + 12345;
+                        const double noise = 0.01*(((seed >> 8) % 1000) / 1000.0 - 0.5);
+                        f(i,j,ch) = offset + slope_x*(j-j_0) + slope_y*(i-i_0) + noise;
+                    }
+                }
+            }
+            i_0 = i_1;
+        }
+        j_0 = j_1;
+    }
+}
+
+// Setting of the calibration solves of one direction
+struct CalibrationSetting {
+    const cube* f;
+    ADMMState initial_state;    // Each timed solve starts from this state
+    ADMMState* state;
+    int s;
+    double gamma_s;
+    double eta;
+    mat C_linear, S_linear, C_const, S_const;
+    StripePlan plan_in_place;
+    StripePlan plan_packed;
+    PackedData packed;
+};
+
+// Fastest time of the calibration solves with the given configuration
+static double TimeConfig(CalibrationSetting &setting, const DirectionConfig &config)
+{
+    omp_set_num_threads(config.nr_threads);
+    omp_set_schedule(config.schedule,config.chunk);
+    const StripePlan &plan = config.packed_layout ? setting.plan_packed : setting.plan_in_place;
+    double best = -1;
+    for(int k = 0; k < CALIBRATION_REPETITIONS; k++) {
+        // A solve changes the state, all configurations are timed on the same subproblems
+        *setting.state = setting.initial_state;
+        const double start = omp_get_wtime();
+        FusedLinewiseSolver(*setting.f,*setting.state,setting.s,plan,setting.gamma_s,setting.eta,
+                            setting.C_linear,setting.S_linear,setting.C_const,setting.S_const,setting.packed);
+        const double seconds = omp_get_wtime()-start;
+        if (best < 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+DirectionConfig CalibrateDirection(const int m, const int n, const int nr_channels, const int s,
+                                   const ADMMParameters &par)
+{
+    const int nr_dirs = par.nr_dirs;
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(nr_dirs,dirs,omegas);
+    vec dir_s(2);
+    dir_s(0) = dirs(0,s);
+    dir_s(1) = dirs(1,s);
+
+    // Synthetic data and the coupling penalties of an intermediate iteration
+    cube f;
+    SyntheticImage(m,n,nr_channels,f);
+    ADMMState state;
+    InitADMMState(state,f,nr_dirs);
+    state.mu = 1e-3*pow(par.mu_nu_step,CALIBRATION_ITERATION);
+    state.nu = min(450*par.gamma*1e-3,1.0)*pow(par.mu_nu_step,CALIBRATION_ITERATION);
+    CalibrationSetting setting;
+    setting.f = &f;
+    setting.initial_state = state;
+    setting.state = &state;
+    setting.s = s;
+    setting.eta = sqrt((2+state.mu*nr_dirs*(nr_dirs-1))/(state.nu*nr_dirs*(nr_dirs-1)));
+    setting.gamma_s = (2*omegas(s)*par.gamma) / ((nr_dirs-1)*state.nu);
+    CalcGivensAngles(max(m,n),setting.eta,setting.C_linear,setting.S_linear,setting.C_const,setting.S_const);
+    const uword long_stripe_length = LongStripeLength(par,m,n);
+    CreateStripePlan(dir_s,m,n,false,long_stripe_length,setting.plan_in_place);
+    CreateStripePlan(dir_s,m,n,true,long_stripe_length,setting.plan_packed);
+
+    // Coordinate search: layout, thread count, schedule (the thread count and run-time schedule of the
+    // host are restored afterwards)
+    const int host_threads = omp_get_max_threads();
+    omp_sched_t host_schedule;
+    int host_chunk;
+    omp_get_schedule(&host_schedule,&host_chunk);
+    DirectionConfig best = DefaultDirectionConfig(par);
+    best.nr_threads = omp_get_num_procs();
+    best.packed_layout = !setting.plan_packed.positions.is_empty();
+    best.seconds = TimeConfig(setting,best);
+    if (best.packed_layout) {
+        DirectionConfig config = best;
+        config.packed_layout = false;
+        config.seconds = TimeConfig(setting,config);
+        if (config.seconds < best.seconds)
+            best = config;
+    }
+    for(int nr_threads = best.nr_threads/2; nr_threads >= 1; nr_threads /= 2) {
+        DirectionConfig config = best;
+        config.nr_threads = nr_threads;
+        config.seconds = TimeConfig(setting,config);
+        if (config.seconds < best.seconds)
+            best = config;
+        else if (config.seconds > THREAD_SEARCH_SLOWDOWN*best.seconds)
+            break;
+    }
+    const omp_sched_t schedules[4] = {omp_sched_dynamic, omp_sched_dynamic, omp_sched_guided, omp_sched_static};
+    const int chunks[4] = {4, 16, 1, 0};
+    for(int k = 0; k < 4; k++) {
+        DirectionConfig config = best;
+        config.schedule = schedules[k];
+        config.chunk = chunks[k];
+        config.seconds = TimeConfig(setting,config);
+        if (config.seconds < best.seconds)
+            best = config;
+    }
+    omp_set_num_threads(host_threads);
+    omp_set_schedule(host_schedule,host_chunk);
+    return best;
+}
+
+bool Autotune(const int m, const int n, const int nr_channels, const ADMMParameters &par)
+{
+    TuningProfile profile;
+    if (par.tuning_profile == NULL || !profile.load(par.tuning_profile))
+        return false;
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(par.nr_dirs,dirs,omegas);
+    bool changed = false;
+    for(int s = 0; s < par.nr_dirs; s++) {
+        DirectionConfig config;
+        if (profile.lookup(m,n,nr_channels,dirs(0,s),dirs(1,s),config))
+            continue;
+        config = CalibrateDirection(m,n,nr_channels,s,par);
+        if (par.verbose)
+            printf("Calibrated direction (%d,%d): %d threads, %s schedule (chunk %d), %s layout, %.4f s\n",
+                   (int) dirs(0,s),(int) dirs(1,s),config.nr_threads,ScheduleName(config.schedule),config.chunk,
+                   config.packed_layout ? "packed" : "in-place",config.seconds);
+        profile.store(m,n,nr_channels,dirs(0,s),dirs(1,s),config);
+        changed = true;
+    }
+    return !changed || profile.save();
+}
+
+void TunedConfigs(const int m, const int n, const int nr_channels, const ADMMParameters &par,
+                  vector<DirectionConfig> &configs)
+{
+    configs.assign(par.nr_dirs,DefaultDirectionConfig(par));
+    TuningProfile profile;
+    if (par.tuning_profile == NULL || !profile.load(par.tuning_profile))
+        return;
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(par.nr_dirs,dirs,omegas);
+    for(int s = 0; s < par.nr_dirs; s++)
+        profile.lookup(m,n,nr_channels,dirs(0,s),dirs(1,s),configs[s]);
+}
+
+// Auxiliary functions
+
+static const char* ScheduleName(const omp_sched_t schedule)
+{
+    switch (schedule) {
+        case omp_sched_static:
+            return "static";
+        case omp_sched_guided:
+            return "guided";
+        default:
+            return "dynamic";
+    }
+}
+
+static bool ParseSchedule(const char* name, omp_sched_t &schedule)
+{
+    if (strcmp(name,"static") == 0)
+        schedule = omp_sched_static;
+    else if (strcmp(name,"dynamic") == 0)
+        schedule = omp_sched_dynamic;
+    else if (strcmp(name,"guided") == 0)
+        schedule = omp_sched_guided;
+    else
+        return false;
+    return true;
+}
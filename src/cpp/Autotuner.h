@@ -0,0 +1,63 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <map>
+#include <string>
+#include "linewiseAffineMS.h"
+
+// Configuration of the stripe loop of one direction
+struct DirectionConfig {
+    int nr_threads;         // Number of OpenMP threads
+    omp_sched_t schedule;   // Schedule of the loop over stripes (set by omp_set_schedule)
+    int chunk;              // Chunk size of the schedule
+    bool packed_layout;     // Solve the stripes on the packed layout (diagonal/horizontal directions)
+    double seconds;         // Calibrated time of one direction solve
+};
+
+// Persistent profile of the best configuration per (shape, channels, direction); stored as text file
+// with one line "m n nr_channels x_dir y_dir nr_threads schedule chunk packed_layout seconds" per entry
+class TuningProfile
+{
+private:
+    std::string path;
+    std::map<std::string,DirectionConfig> entries;
+    static std::string key(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir);
+    bool write() const;
+public:
+    // Getter
+    const std::string &getPath() const;
+    // Constructor
+    TuningProfile();
+    // Reads the profile (a missing file is an empty profile); returns false if the file is malformed
+    bool load(const char* profile_path);
+    // Writes the profile (atomically by renaming a temporary file) under an exclusive lock of path.lock,
+    // after adding the entries that other processes saved since it was loaded (their entries are kept);
+    // returns false on failure
+    bool save();
+    // Identifies the version of the profile file (inode, size and modification time; empty if it is missing)
+    static std::string fileVersion(const char* profile_path);
+    // Returns true and the configuration if the profile has an entry for the shape and direction
+    bool lookup(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir,
+                DirectionConfig &config) const;
+    // Adds or replaces an entry
+    void store(const int m, const int n, const int nr_channels, const int x_dir, const int y_dir,
+               const DirectionConfig &config);
+};
+
+// Default configuration (nr_threads of par, dynamic schedule with chunk 1, layout of par)
+DirectionConfig DefaultDirectionConfig(const ADMMParameters &par);
+
+// Runs calibration solves of the direction dir on a synthetic piecewise affine image of the given shape
+// and returns the fastest configuration (thread count, schedule/chunk, packed or in-place layout)
+DirectionConfig CalibrateDirection(const int m, const int n, const int nr_channels, const int s,
+                                   const ADMMParameters &par);
+
+// Calibrates all directions of the shape that are missing in the profile par.tuning_profile and saves it;
+// returns false if the profile cannot be read or written
+bool Autotune(const int m, const int n, const int nr_channels, const ADMMParameters &par);
+
+// Configurations of all directions from the profile par.tuning_profile (defaults for missing entries)
+void TunedConfigs(const int m, const int n, const int nr_channels, const ADMMParameters &par,
+                  vector<DirectionConfig> &configs);
+
+#endif
@@ -0,0 +1,59 @@
+/**
+    CalcGivensAngles.cpp
+    Purpose: Computes the recurrence coefficients necessary for the solver of the
+             univariate subproblems, i.e., the Givens rotation angles of the QR
+             decomposition of the least squares system (cf. calcGivensAngles.m)
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+void CalcGivensAngles(const int n, const double eta, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const)
+{
+    // The matrix A_q of eq. (27) is treated separately w.r.t. the 2nd column removed
+    // (A, linear part) and the 2nd column (B, pure constant part)
+    mat A = zeros(2*n,2);
+    for(int i = 0; i < n; i++) {
+        A(2*i,0) = eta*(i+1);
+        A(2*i,1) = eta;
+        A(2*i+1,0) = 1;
+    }
+    C_linear = zeros(2*n,2);
+    S_linear = zeros(2*n,2);
+    C_const = zeros(n,1);
+    S_const = zeros(n,1);
+
+    double rho,c,s,aj_old,ai_old;
+    // Linear part
+    for(int i = 1; i < 2*n; i++) {
+        for(int j = 0; j < min(2,i); j++) {
+            if (A(i,j) == 0)
+                continue;
+            // Update Givens rotation coefficients
+            rho = (A(j,j) >= 0 ? 1 : -1)*sqrt(A(j,j)*A(j,j) + A(i,j)*A(i,j));
+            c = A(j,j)/rho;
+            s = A(i,j)/rho;
+            C_linear(i,j) = c;
+            S_linear(i,j) = s;
+            // Update A
+            for(int k = 0; k < 2; k++) {
+                aj_old = A(j,k);
+                ai_old = A(i,k);
+                A(j,k) = c*aj_old + s*ai_old;
+                A(i,k) = -s*aj_old + c*ai_old;
+            }
+        }
+    }
+    // Pure constant part
+    double b_1 = 1;
+    for(int i = 1; i < n; i++) {
+        rho = sqrt(b_1*b_1 + 1);
+        c = b_1/rho;
+        s = 1/rho;
+        C_const(i,0) = c;
+        S_const(i,0) = s;
+        b_1 = c*b_1 + s;
+    }
+}
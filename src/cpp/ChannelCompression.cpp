@@ -0,0 +1,59 @@
+/**
+    ChannelCompression.cpp
+    Purpose: Exact compression of the channels of images with many (e.g. hyperspectral) bands
+             The approximation errors of the model are sums of squares over the channels, hence they are
+             invariant under orthogonal transforms of the channel space, and the ADMM iterates stay in the
+             span of the channel vectors of the image. If this span has a lower dimension than the number of
+             channels, the problem is solved on the coordinates of the image w.r.t. an orthonormal basis of
+             the span and the result is mapped back.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <cstring>
+#include "linewiseAffineMS.h"
+
+// Channel directions whose energy is below this fraction of the largest one are numerically zero
+// (far below the quantization of 16-bit data)
+static const double COMPRESSION_TOL = 1e-12;
+
+mat ChannelBasis(const cube &f)
+{
+    const uword nr_channels = f.n_slices;
+    // Channel vectors of all pixels as rows (the channels of a pixel are one slice apart)
+    const mat X(const_cast<double*>(f.memptr()),f.n_rows*f.n_cols,nr_channels,false,true);
+    const mat gram = X.t()*X;
+    vec eigval;
+    mat eigvec;
+    if (!eig_sym(eigval,eigvec,gram))
+        return mat();
+    // Eigenvalues are in ascending order
+    const double tol = COMPRESSION_TOL*eigval(nr_channels-1);
+    uword rank = 0;
+    while (rank < nr_channels && eigval(nr_channels-1-rank) > tol)
+        rank++;
+    rank = max(rank,(uword) 1);
+    // Basis vectors in descending order of their energy
+    mat basis(nr_channels,rank);
+    for(uword k = 0; k < rank; k++)
+        memcpy(basis.colptr(k),eigvec.colptr(nr_channels-1-k),nr_channels*sizeof(double));
+    return basis;
+}
+
+void CompressChannels(const cube &x, const mat &basis, cube &x_compressed)
+{
+    const uword nr_pixels = x.n_rows*x.n_cols;
+    x_compressed.set_size(x.n_rows,x.n_cols,basis.n_cols);
+    const mat X(const_cast<double*>(x.memptr()),nr_pixels,x.n_slices,false,true);
+    mat X_compressed(x_compressed.memptr(),nr_pixels,basis.n_cols,false,true);
+    X_compressed = X*basis;
+}
+
+void ExpandChannels(const cube &x_compressed, const mat &basis, cube &x)
+{
+    const uword nr_pixels = x_compressed.n_rows*x_compressed.n_cols;
+    const mat X_compressed(const_cast<double*>(x_compressed.memptr()),nr_pixels,x_compressed.n_slices,false,true);
+    mat X(x.memptr(),nr_pixels,basis.n_rows,false,true);
+    X = X_compressed*basis.t();
+}
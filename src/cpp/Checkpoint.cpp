@@ -0,0 +1,226 @@
+/**
+    Checkpoint.cpp
+    Purpose: Writes the full ADMM state (splitting variables, multipliers, coupling penalties and
+             iteration index) to a compact binary file and reads it back, so that a preempted solve
+             can be resumed; with a double precision checkpoint the resumed iterations are bit-exact.
+             Periodic checkpoints are written by a background thread from a copy of the state.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Checkpoint.h"
+
+static const uint32_t CHECKPOINT_VERSION = 3;
+// Number of elements converted per write in single precision checkpoints
+static const size_t CONVERSION_CHUNK = 1 << 16;
+
+uint64_t ImageHash(const cube &f)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* data = (const unsigned char*) f.memptr();
+    const size_t size = f.n_elem*sizeof(double);
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Appends the cube in the element type of the checkpoint; returns false on failure
+static bool WriteArray(FILE* file, const cube &x, const bool float32)
+{
+    if (!float32)
+        return fwrite(x.memptr(),sizeof(double),x.n_elem,file) == x.n_elem;
+    vector<float> buffer(min((size_t) x.n_elem,CONVERSION_CHUNK));
+    const double* x_raw = x.memptr();
+    for(size_t start = 0; start < x.n_elem; start += CONVERSION_CHUNK) {
+        const size_t count = min((size_t) x.n_elem-start,CONVERSION_CHUNK);
+        for(size_t i = 0; i < count; i++)
+            buffer[i] = (float) x_raw[start+i];
+        if (fwrite(buffer.data(),sizeof(float),count,file) != count)
+            return false;
+    }
+    return true;
+}
+
+bool WriteCheckpoint(const char* path, const ADMMState &state, const ADMMParameters &par, const uint64_t f_hash)
+{
+    const bool float32 = par.checkpoint_float32;
+    const cube &u_0 = state.us[0];
+    CheckpointHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,"PLCK",4);
+    header.version = CHECKPOINT_VERSION;
+    header.dtype = float32 ? CHECKPOINT_FLOAT32 : CHECKPOINT_FLOAT64;
+    header.m = u_0.n_rows;
+    header.n = u_0.n_cols;
+    header.nr_channels = u_0.n_slices;
+    header.nr_dirs = state.nr_dirs;
+    header.has_jumps = !state.jumps.empty();
+    header.iteration = state.iteration;
+    header.nr_penalties = state.mus.size();
+    header.f_hash = f_hash;
+    header.mu = state.mu;
+    header.nu = state.nu;
+    header.deviation = state.deviation;
+    header.penalty_step = state.penalty_step;
+    header.gamma = par.gamma;
+    header.mu_nu_step = par.mu_nu_step;
+    header.adaptive_penalties = par.adaptive_penalties;
+    header.jacobi = par.jacobi;
+
+    const std::string tmp_path = std::string(path) + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(),"wb");
+    if (file == NULL)
+        return false;
+    bool ok = (fwrite(&header,sizeof(header),1,file) == 1);
+    const vector<cube>* arrays[6] = {&state.us, &state.as, &state.bs, &state.lambdas, &state.taus, &state.rhos};
+    for(int k = 0; k < 6 && ok; k++) {
+        for(size_t s = 0; s < arrays[k]->size() && ok; s++)
+            ok = WriteArray(file,(*arrays[k])[s],float32);
+    }
+    for(size_t s = 0; s < state.jumps.size() && ok; s++)
+        ok = (fwrite(state.jumps[s].memptr(),1,state.jumps[s].n_elem,file) == state.jumps[s].n_elem);
+    ok = ok && (fwrite(state.mus.data(),sizeof(double),state.mus.size(),file) == state.mus.size());
+    ok = ok && (fwrite(state.nus.data(),sizeof(double),state.nus.size(),file) == state.nus.size());
+    // The data has to be on disk before the checkpoint replaces the previous one
+    ok = ok && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(),path) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Copies n_elem elements of the checkpoint's element type from data into the cube
+static const unsigned char* ReadArray(const unsigned char* data, const bool float32, cube &x)
+{
+    if (!float32) {
+        memcpy(x.memptr(),data,x.n_elem*sizeof(double));
+        return data + x.n_elem*sizeof(double);
+    }
+    const float* values = (const float*) data;
+    double* x_raw = x.memptr();
+    for(uword i = 0; i < x.n_elem; i++)
+        x_raw[i] = values[i];
+    return data + x.n_elem*sizeof(float);
+}
+
+bool ReadCheckpoint(const char* path, const cube &f, const ADMMParameters &par, ADMMState &state)
+{
+    int fd = open(path,O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd,&st) != 0 || (size_t) st.st_size < sizeof(CheckpointHeader)) {
+        close(fd);
+        return false;
+    }
+    const size_t size = st.st_size;
+    void* map = mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    CheckpointHeader header;
+    memcpy(&header,map,sizeof(header));
+    const int nr_dirs = header.nr_dirs;
+    const int nr_pairs = (nr_dirs*(nr_dirs-1))/2;
+    const size_t nr_elem = (size_t) header.m*header.n*header.nr_channels;
+    const size_t elem_size = (header.dtype == CHECKPOINT_FLOAT32) ? sizeof(float) : sizeof(double);
+    const size_t expected = sizeof(header) + (size_t) (3*nr_dirs+3*nr_pairs)*nr_elem*elem_size +
+                            (header.has_jumps ? (size_t) nr_dirs*header.m*header.n : 0) +
+                            (size_t) 2*header.nr_penalties*sizeof(double);
+    bool valid = memcmp(header.magic,"PLCK",4) == 0 && header.version == CHECKPOINT_VERSION &&
+                 header.dtype <= CHECKPOINT_FLOAT32 && (nr_dirs == 2 || nr_dirs == 4) &&
+                 header.iteration >= 0 && header.iteration <= par.max_iter &&
+                 header.nr_penalties <= (uint32_t) header.iteration && size == expected &&
+                 std::isfinite(header.mu) && header.mu > 0 && std::isfinite(header.nu) && header.nu > 0 &&
+                 header.m == f.n_rows && header.n == f.n_cols && header.nr_channels == f.n_slices &&
+                 header.f_hash == ImageHash(f) && nr_dirs == par.nr_dirs && header.gamma == par.gamma &&
+                 header.mu_nu_step == par.mu_nu_step && header.adaptive_penalties == (uint32_t) par.adaptive_penalties &&
+                 header.jacobi == (uint32_t) par.jacobi;
+    if (valid) {
+        const bool float32 = (header.dtype == CHECKPOINT_FLOAT32);
+        InitADMMState(state,f,nr_dirs);
+        const unsigned char* data = (const unsigned char*) map + sizeof(header);
+        vector<cube>* arrays[6] = {&state.us, &state.as, &state.bs, &state.lambdas, &state.taus, &state.rhos};
+        for(int k = 0; k < 6; k++) {
+            for(size_t s = 0; s < arrays[k]->size(); s++)
+                data = ReadArray(data,float32,(*arrays[k])[s]);
+        }
+        if (header.has_jumps) {
+            state.jumps.assign(nr_dirs,Mat<unsigned char>(header.m,header.n));
+            for(int s = 0; s < nr_dirs; s++) {
+                memcpy(state.jumps[s].memptr(),data,state.jumps[s].n_elem);
+                data += state.jumps[s].n_elem;
+            }
+        }
+        state.mus.resize(header.nr_penalties);
+        state.nus.resize(header.nr_penalties);
+        if (header.nr_penalties > 0) {
+            memcpy(state.mus.data(),data,header.nr_penalties*sizeof(double));
+            data += header.nr_penalties*sizeof(double);
+            memcpy(state.nus.data(),data,header.nr_penalties*sizeof(double));
+        }
+        state.iteration = header.iteration;
+        state.mu = header.mu;
+        state.nu = header.nu;
+        state.deviation = header.deviation;
+        state.penalty_step = header.penalty_step;
+    }
+    munmap(map,size);
+    return valid;
+}
+
+// Constructor
+CheckpointWriter::CheckpointWriter(const ADMMParameters &par, const cube &f) : par(par), writing(false)
+{
+    if (par.checkpoint_path != NULL) {
+        path = par.checkpoint_path;
+        f_hash = ImageHash(f);
+    } else {
+        f_hash = 0;
+    }
+    failed = false;
+}
+
+// Destructor
+CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+}
+
+void CheckpointWriter::write()
+{
+    if (!WriteCheckpoint(path.c_str(),snapshot,par,f_hash))
+        failed = true;
+    writing = false;
+}
+
+bool CheckpointWriter::submit(const ADMMState &state)
+{
+    if (path.empty() || writing)
+        return false;
+    if (worker.joinable())
+        worker.join();
+    snapshot = state;
+    writing = true;
+    worker = std::thread(&CheckpointWriter::write,this);
+    return true;
+}
+
+bool CheckpointWriter::wait()
+{
+    if (worker.joinable())
+        worker.join();
+    return !failed;
+}
@@ -0,0 +1,74 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "linewiseAffineMS.h"
+
+// Checkpoint of the ADMM state (native byte order): CheckpointHeader, followed by the column-major
+// m x n x nr_channels arrays us[0..nr_dirs), as[..], bs[..], lambdas[0..nr_pairs), taus[..], rhos[..]
+// of element type dtype, if has_jumps is set, the m x n jump indicators (uint8) of each direction and the
+// coupling penalties mu, nu (float64) of the first nr_penalties iterations (mus[..], nus[..]).
+// The arrays are stored without padding, so the file can be memory-mapped.
+struct CheckpointHeader {
+    char magic[4];          // "PLCK"
+    uint32_t version;
+    uint32_t dtype;         // CHECKPOINT_FLOAT64 or CHECKPOINT_FLOAT32
+    uint32_t m;
+    uint32_t n;
+    uint32_t nr_channels;
+    uint32_t nr_dirs;
+    uint32_t has_jumps;
+    int32_t iteration;
+    uint32_t nr_penalties;  // Length of the penalty history (at most iteration)
+    uint64_t f_hash;        // Hash of the input image (a checkpoint only resumes the solve of the same image)
+    double mu;
+    double nu;
+    double deviation;
+    double penalty_step;
+    double gamma;           // Parameters of the solve (a checkpoint only resumes a solve with the same ones)
+    double mu_nu_step;
+    uint32_t adaptive_penalties;
+    uint32_t jacobi;
+};
+enum { CHECKPOINT_FLOAT64 = 0, CHECKPOINT_FLOAT32 = 1 };
+
+// FNV-1a hash of the image data
+uint64_t ImageHash(const cube &f);
+
+// Writes the state of a solve with parameters par to path (via a temporary file that is renamed, so an
+// existing checkpoint stays valid until the new one is complete); returns false on failure
+bool WriteCheckpoint(const char* path, const ADMMState &state, const ADMMParameters &par, const uint64_t f_hash);
+
+// Reads the state of the solve of f from a checkpoint; returns false if the file cannot be read, does not
+// belong to f and the parameters par (gamma, nr_dirs, mu_nu_step, adaptive_penalties, jacobi), its iteration
+// is not in 0,...,par.max_iter or its coupling penalties are not positive and finite
+bool ReadCheckpoint(const char* path, const cube &f, const ADMMParameters &par, ADMMState &state);
+
+// Writes checkpoints in a background thread, so that the iterations continue while a checkpoint is written
+class CheckpointWriter
+{
+private:
+    std::string path;
+    ADMMParameters par;
+    uint64_t f_hash;
+    ADMMState snapshot;         // Copy of the state that is being written
+    std::thread worker;
+    std::atomic<bool> writing;
+    bool failed;
+    void write();
+public:
+    // Constructor (par.checkpoint_path may be NULL, then no checkpoints are written)
+    CheckpointWriter(const ADMMParameters &par, const cube &f);
+    // Destructor (waits for the pending checkpoint)
+    ~CheckpointWriter();
+    // Starts writing a copy of the state; returns false (and skips the checkpoint) if the previous one
+    // is still being written
+    bool submit(const ADMMState &state);
+    // Waits for the pending checkpoint; returns false if a checkpoint could not be written
+    bool wait();
+};
+
+#endif
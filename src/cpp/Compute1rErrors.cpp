@@ -20,7 +20,8 @@ vec Compute1rErrors(mat u_data, mat a_data,mat b_data, const int nr_channels,
     Interval err = Interval(1,1,nr_channels,u_data.col(0),a_data.col(0),b_data.col(0));
     for(int r =1; r < n; r++){
         // Compute the approximation error for interval [1,r] using the error update function of the Interval class
-        err.addBottomDataPoint(nr_channels, C_linear,S_linear,C_const, S_const,u_data.col(r),a_data.col(r),b_data.col(r));
+        err.addBottomDataPoint(nr_channels, C_linear,S_linear,C_const, S_const,1.0,
+                               u_data.colptr(r),a_data.colptr(r),b_data.colptr(r));
         eps1R(r) = err.getEps();
     }
     
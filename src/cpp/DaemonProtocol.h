@@ -0,0 +1,56 @@
+#ifndef DAEMONPROTOCOL_H
+#define DAEMONPROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Protocol of the solver daemon palmsd (PalmsDaemon.cpp) on a Unix domain socket of type SOCK_SEQPACKET.
+// A solve request passes the descriptor of a shared memory file with SCM_RIGHTS; the file has to be a memfd
+// sealed against shrinking (F_SEAL_SHRINK, requests with other files are rejected) and holds
+//   f, u, a, b, c (m x n x nr_channels doubles each, column-major as in PalmsAPI.h) and partition (m x n int32)
+// one after another, so the daemon reads the input and writes the outputs in place and no image data passes
+// through the socket. Every request is answered by a DaemonReply; the reply of a stats request is followed
+// by a message with the report text.
+
+#define DAEMON_DEFAULT_SOCKET "/tmp/palmsd.sock"
+
+enum { DAEMON_SOLVE = 0, DAEMON_STATS = 1, DAEMON_SHUTDOWN = 2 };
+
+// Max size of the stats report message
+static const size_t DAEMON_MAX_REPORT = 16384;
+
+struct DaemonRequest {
+    char magic[4];              // "PLMD"
+    uint32_t type;              // DAEMON_SOLVE, DAEMON_STATS or DAEMON_SHUTDOWN
+    int32_t m;
+    int32_t n;
+    int32_t nr_channels;
+    int32_t max_iter;
+    int32_t isotropic;
+    int32_t adaptive_penalties;
+    int32_t jacobi;
+    int32_t compress_channels;
+    double gamma;
+    double mu_nu_step;
+    double split_tol;
+    double time_budget;
+};
+
+struct DaemonReply {
+    char magic[4];              // "PLMD"
+    int32_t status;             // palms_status of the request
+    int32_t nr_iterations;
+    uint32_t reserved;
+    double solve_seconds;       // Time of the solve
+    double service_seconds;     // Time from receiving the request to sending the reply
+};
+
+// Byte offset of array k (0: f, 1: u, 2: a, 3: b, 4: c, 5: partition) in the shared memory file;
+// k = 6 gives the size of the file
+inline size_t SharedImageOffset(const int m, const int n, const int nr_channels, const int k)
+{
+    const size_t image_size = (size_t) m*n*nr_channels*sizeof(double);
+    return (k <= 5) ? k*image_size : 5*image_size + (size_t) m*n*sizeof(int32_t);
+}
+
+#endif
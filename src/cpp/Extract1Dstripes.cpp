@@ -1,7 +1,7 @@
 /**
     Extract1Dstripes.cpp
     Purpose: Extract the stripes of the input image for input direction and 
-             stores them as Stripe objects in a vector
+             stores them as Stripe objects in a vector (or only their linear indices)
 
     @author Lukas Kiefer
     @version 1.0
@@ -11,6 +11,16 @@
 void AssignDataAndIndices(uvec &indices_flat, const int m, const int n, const int nr_channels, const cube &I,std::vector<Stripe>  &L);
 
 void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, const int m, const int n,const int nr_channels)
+{
+    std::vector<uvec> stripe_indices;
+    ExtractStripeIndices(dir,stripe_indices,m,n);
+    for(unsigned int iter = 0; iter < stripe_indices.size(); ++iter) {
+        // Append the data and the linear indices to the vector L
+        AssignDataAndIndices(stripe_indices[iter],m,n,nr_channels,I,L);
+    }
+}
+
+void ExtractStripeIndices(const vec &dir, std::vector<uvec> &L, const int m, const int n)
 {
     int x_dir = dir(0);
     int y_dir = dir(1);
@@ -27,8 +37,7 @@ void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, con
                 x_cor = j;
                 y_cor = row;
                 uvec indices_flat = GetIndexes(n, x_cor, x_dir, m,y_cor,y_dir);
-                // Append the data and the linear indices to the vector L
-                AssignDataAndIndices(indices_flat,m,n,nr_channels,I,L);
+                L.push_back(indices_flat);
             }
         }
         // Startpoints: Cols
@@ -37,8 +46,7 @@ void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, con
                 x_cor = col;
                 y_cor = i;
                 uvec indices_flat = GetIndexes(n, x_cor, x_dir, m,y_cor,y_dir);
-                // Append the data and the linear indices to the vector L
-                AssignDataAndIndices(indices_flat,m,n,nr_channels,I,L);
+                L.push_back(indices_flat);
             }
         }
     } else {
@@ -48,8 +56,7 @@ void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, con
                 x_cor = j;
                 y_cor = row;
                 uvec indices_flat = GetIndexes(n, x_cor, x_dir, m,y_cor,y_dir);
-                // Append the data and the linear indices to the vector L
-                AssignDataAndIndices(indices_flat,m,n,nr_channels,I,L); 
+                L.push_back(indices_flat);
             }
         }
         // Startpoints: Cols
@@ -58,13 +65,35 @@ void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, con
                 x_cor = col;
                 y_cor = i;
                 uvec indices_flat = GetIndexes(n, x_cor, x_dir, m,y_cor,y_dir);
-                // Append the data and the linear indices to the vector L
-                AssignDataAndIndices(indices_flat,m,n,nr_channels,I,L);
+                L.push_back(indices_flat);
             }
         }
     }
 }
 
+void CreateStripePlan(const vec &dir, const int m, const int n, const bool packed, const uword long_stripe_length,
+                      StripePlan &plan)
+{
+    plan.long_stripe_length = long_stripe_length;
+    plan.stripes.clear();
+    ExtractStripeIndices(dir,plan.stripes,m,n);
+    plan.offsets = uvec(plan.stripes.size()+1);
+    plan.offsets(0) = 0;
+    for(unsigned int iter = 0; iter < plan.stripes.size(); ++iter)
+        plan.offsets(iter+1) = plan.offsets(iter) + plan.stripes[iter].n_elem;
+    // Vertical stripes are the columns of the image and need no copy
+    const bool contiguous = (dir(0) == 0);
+    if (!packed || contiguous) {
+        plan.positions.reset();
+        return;
+    }
+    plan.positions = uvec(m*n);
+    for(unsigned int iter = 0; iter < plan.stripes.size(); ++iter) {
+        const uvec &indices = plan.stripes[iter];
+        for(uword i = 0; i < indices.n_elem; i++)
+            plan.positions(indices(i)) = plan.offsets(iter) + i;
+    }
+}
 
 void AssignDataAndIndices(uvec &indices_flat, const int m, const int n, const int nr_channels, const cube &I,std::vector<Stripe>  &L){
     int t = indices_flat.n_elem;
@@ -21,9 +21,6 @@ void FindBest1DPartition(mat u_data,mat a_data,mat b_data,const int n, const int
     segments.push_front(Interval(2,2,nr_channels,eta*u_data.col(1),a_data.col(1),b_data.col(1)));
     // Local aux variables
     double b;
-    vec udata_new(nr_channels);
-    vec adata_new(nr_channels);
-    vec bdata_new(nr_channels);
     
     for(int r=2; r<=n; r++) {
         // Init with approximation error of single-segment partition, i.e. l = 1:
@@ -34,12 +31,10 @@ void FindBest1DPartition(mat u_data,mat a_data,mat b_data,const int n, const int
         for(list<Interval>::iterator it = segments.begin(); it != segments.end(); ++it) {
             Interval &curr_interval = *it;
             while (curr_interval.getR() < r){
-                // Get data of new index r
-                udata_new = eta*u_data.col(curr_interval.getR());
-                adata_new = a_data.col(curr_interval.getR());
-                bdata_new = b_data.col(curr_interval.getR());
-                // Extend current interval by new data and update its approximation error with Givens rotations
-                curr_interval.addBottomDataPoint(nr_channels, C_linear,S_linear,C_const, S_const,udata_new,adata_new,bdata_new);
+                // Extend current interval by the data of new index r and update its approximation error with Givens rotations
+                const uword R = curr_interval.getR();
+                curr_interval.addBottomDataPoint(nr_channels, C_linear,S_linear,C_const, S_const,eta,
+                                                 u_data.colptr(R),a_data.colptr(R),b_data.colptr(R));
             }
             // Check if current interval has better energy
             b = B(curr_interval.getL() - 2) + gamma + curr_interval.getEps();
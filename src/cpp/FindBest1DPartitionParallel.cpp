@@ -0,0 +1,109 @@
+/**
+    FindBest1DPartitionParallel.cpp
+    Purpose: Computes the best (piecewise affine-linear) partition for univariate Jet data
+             by dynamic programming as FindBest1DPartition, for very long stripes
+             For each r, the first candidates (last changepoints) are scanned sequentially;
+             if the pruning does not stop the scan, the remaining candidates are extended to r
+             in parallel blocks (tasks of one parallel region for all r) and the block is then
+             scanned sequentially. The extension of a candidate only depends on its own data,
+             so extending it earlier than the sequential scan would does not change any value,
+             and the result equals FindBest1DPartition.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+#include "Interval.h"
+#include "linewiseAffineMS.h"
+
+// Number of candidates scanned sequentially before the scan continues in parallel blocks
+static const int SEQUENTIAL_CANDIDATES = 256;
+// Number of candidates per thread in a parallel block
+static const int CANDIDATES_PER_THREAD = 64;
+
+// Extends the interval by the data up to index r (1-based)
+static void ExtendInterval(Interval &interval, const int r, const mat &u_data, const mat &a_data, const mat &b_data,
+                           const int nr_channels, const double eta,
+                           const mat &C_linear, const mat &S_linear, const mat &C_const, const mat &S_const)
+{
+    while (interval.getR() < r) {
+        const uword R = interval.getR();
+        interval.addBottomDataPoint(nr_channels,C_linear,S_linear,C_const,S_const,eta,
+                                    u_data.colptr(R),a_data.colptr(R),b_data.colptr(R));
+    }
+}
+
+void FindBest1DPartitionParallel(mat u_data,mat a_data,mat b_data,const int n, const int nr_channels, double &gamma,
+                                 double eta, const vec &eps_1r, mat &C_linear, mat &S_linear,
+                                 mat &C_const, mat &S_const, ivec &L)
+{
+    // Without further threads (or within a parallel region), the sequential scan is used
+    if (omp_get_max_threads() < 2 || omp_in_parallel()) {
+        FindBest1DPartition(u_data,a_data,b_data,n,nr_channels,gamma,eta,eps_1r,C_linear,S_linear,C_const,S_const,L);
+        return;
+    }
+    // Allocate vector with optimal functional values for each r=1,...,n
+    vec B = zeros(n,1);
+    L(0) = 0;
+    // Candidates for the last segment with increasing left bound, i.e., the scan runs backwards
+    std::vector<Interval> segments;
+    segments.reserve(n);
+    segments.push_back(Interval(2,2,nr_channels,eta*u_data.col(1),a_data.col(1),b_data.col(1)));
+    const int block_size = omp_get_max_threads()*CANDIDATES_PER_THREAD;
+    // Local aux variables
+    double b;
+
+    // One parallel region for all r: one thread scans, the others wait at the end of the single construct and
+    // take the extension tasks of the parallel blocks (no fork and join per r)
+    #pragma omp parallel
+    #pragma omp single
+    for(int r=2; r<=n; r++) {
+        // Init with approximation error of single-segment partition, i.e. l = 1:
+        B(r-1) = eps_1r(r-1);
+        L(r-1) = 0;
+
+        // Loop (backwards in l) through candidates for (best) last changepoint
+        int k = segments.size()-1;
+        int nr_scanned = 0;
+        bool pruned = false;
+        while (k >= 0 && !pruned) {
+            // Candidates k_end < j <= k of this block
+            int k_end;
+            if (nr_scanned < SEQUENTIAL_CANDIDATES) {
+                // Lazy extension as in the sequential scan
+                k_end = max(k-(SEQUENTIAL_CANDIDATES-nr_scanned),-1);
+            } else {
+                k_end = max(k-block_size,-1);
+                for(int k_task = k; k_task > k_end; k_task -= CANDIDATES_PER_THREAD) {
+                    #pragma omp task firstprivate(k_task)
+                    for(int j = k_task; j > max(k_task-CANDIDATES_PER_THREAD,k_end); j--)
+                        ExtendInterval(segments[j],r,u_data,a_data,b_data,nr_channels,eta,
+                                       C_linear,S_linear,C_const,S_const);
+                }
+                #pragma omp taskwait
+            }
+            for(int j = k; j > k_end; j--) {
+                Interval &curr_interval = segments[j];
+                ExtendInterval(curr_interval,r,u_data,a_data,b_data,nr_channels,eta,
+                               C_linear,S_linear,C_const,S_const);
+                // Check if current interval has better energy
+                b = B(curr_interval.getL() - 2) + gamma + curr_interval.getEps();
+                if (b <= B(r-1)) {
+                    B(r-1) = b;
+                    L(r-1) = curr_interval.getL()-1;
+                }
+                // Pruning-strategy (omit unnecessary computations of approximation errors)
+                if (curr_interval.getEps()+gamma > B(r-1)) {
+                    pruned = true;
+                    break;
+                }
+            }
+            nr_scanned += k-k_end;
+            k = k_end;
+        }
+        // Add interval with left r bound to the list of candidates
+        if (r<=n-1) {
+            // add l=r+1
+            segments.push_back(Interval(r+1,r+1,nr_channels,eta*u_data.col(r),a_data.col(r),b_data.col(r)));
+        }
+    }
+}
@@ -0,0 +1,368 @@
+/**
+    FusedLinewiseSolver.cpp
+    Purpose: Solves the univariate subproblems of the s-th direction of the ADMM scheme
+             While loading a stripe, the subproblem data (lines 6-8 of Algorithm 1) is computed
+             from f, the splitting variables and multipliers of the other directions and the
+             slopes are transformed according to the direction; the results are back transformed
+             on write-back. Hence, no intermediate full-image cubes are created.
+             Stripes that are not contiguous in memory (diagonal and horizontal directions) are
+             loaded into a packed (sheared/transposed) copy by a tiled pass over the image, so that
+             each cache line of the image and of the packed copy is touched once.
+             The Jacobi variant solves the stripes of all directions in one pool, building all
+             subproblems from the previous iterate.
+             The loops over the stripes of one direction use the run-time schedule, which the
+             caller sets per direction (cf. DirectionConfig); the Jacobi pool is scheduled dynamically.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+// Tile size of the passes between image and packed layout
+static const int TILE_ROWS = 64;
+static const int TILE_COLS = 16;
+
+// Computes the subproblem data of direction s from f, the splitting variables and the
+// multipliers of the other directions and writes back the solutions of the subproblems
+class SubproblemData
+{
+private:
+    int s;
+    int nr_others;
+    double mu, nu;
+    double u_weight, u_normalization;
+    const double* f_raw;
+    // Directions t < s enter with +, directions t > s with - (orientation of the pair multipliers)
+    vector<const double*> u_t, a_t, b_t, lambda, tau, rho;
+    vector<double> sign;
+    double* u_s;
+    double* a_s;
+    double* b_s;
+public:
+    // The solutions are written to u_out, a_out, b_out (the splitting variables of direction s for
+    // Gauss-Seidel, the next iterate for the Jacobi variant)
+    SubproblemData(const cube &f, const ADMMState &state, const int s_curr,
+                   cube &u_out, cube &a_out, cube &b_out){
+        const int nr_dirs = state.nr_dirs;
+        s = s_curr;
+        nr_others = nr_dirs-1;
+        mu = state.mu;
+        nu = state.nu;
+        u_weight = mu*nr_dirs;
+        u_normalization = 2+mu*nr_dirs*(nr_dirs-1);
+        f_raw = f.memptr();
+        for(int t = 0; t < nr_dirs; t++) {
+            if (t == s)
+                continue;
+            const int pair = (t < s) ? PairIndex(t,s,nr_dirs) : PairIndex(s,t,nr_dirs);
+            u_t.push_back(state.us[t].memptr());
+            a_t.push_back(state.as[t].memptr());
+            b_t.push_back(state.bs[t].memptr());
+            lambda.push_back(state.lambdas[pair].memptr());
+            tau.push_back(state.taus[pair].memptr());
+            rho.push_back(state.rhos[pair].memptr());
+            sign.push_back((t < s) ? 1 : -1);
+        }
+        u_s = u_out.memptr();
+        a_s = a_out.memptr();
+        b_s = b_out.memptr();
+    }
+    // Subproblem data (offset, slope along and perpendicular to the direction) of element q
+    inline void gather(const uword q, double &u_data, double &x_data, double &y_data) const {
+        double w = 0, y = 0, z = 0;
+        for(int k = 0; k < nr_others; k++) {
+            w = w + u_t[k][q] + sign[k]*lambda[k][q]/mu;
+            y = y + a_t[k][q] + sign[k]*tau[k][q]/nu;
+            z = z + b_t[k][q] + sign[k]*rho[k][q]/nu;
+        }
+        // Offset data
+        u_data = (2*f_raw[q] + u_weight*w) / u_normalization;
+        // Slope data
+        const double as_data = y/nr_others;
+        const double bs_data = z/nr_others;
+        // Transform slope data according to the s-th direction
+        switch (s) {
+            case 0:
+                x_data = bs_data;
+                y_data = as_data;
+                break;
+            case 1:
+                x_data = as_data;
+                y_data = bs_data;
+                break;
+            case 2:
+                x_data = as_data + bs_data;
+                y_data = as_data - bs_data;
+                break;
+            case 3:
+                x_data = as_data - bs_data;
+                y_data = as_data + bs_data;
+                break;
+        }
+    }
+    // Back transforms the slopes and writes the solution to the splitting variables of direction s
+    inline void scatter(const uword q, const double u, const double x, const double y) const {
+        u_s[q] = u;
+        switch (s) {
+            case 0:
+                a_s[q] = y;
+                b_s[q] = x;
+                break;
+            case 1:
+                a_s[q] = x;
+                b_s[q] = y;
+                break;
+            case 2:
+                a_s[q] = (x+y)/2;
+                b_s[q] = (x-y)/2;
+                break;
+            case 3:
+                a_s[q] = (x+y)/2;
+                b_s[q] = (y-x)/2;
+                break;
+        }
+    }
+};
+
+// Long stripes are not solved in the parallel loop over stripes but one after another with the parallel DP
+static inline bool IsLongStripe(const StripePlan &plan, const unsigned int k)
+{
+    return plan.long_stripe_length > 0 && plan.stripes[k].n_elem >= plan.long_stripe_length;
+}
+
+// Gathers, solves and writes back a stripe directly from/to the image
+static void SolveStripeInPlace(const SubproblemData &data, const uvec &linear_indices, const int nr_channels,
+                               const uword nr_pixels, double gamma_s, double eta_s,
+                               mat &C_linear, mat &S_linear, mat &C_const, mat &S_const, const bool parallel_dp)
+{
+    const int stripe_length = linear_indices.n_elem;
+    mat u_data(nr_channels,stripe_length);
+    mat x_data(nr_channels,stripe_length);
+    mat y_data(nr_channels,stripe_length);
+    // Gather the subproblem data of the stripe
+    for(int i = 0; i < stripe_length; i++) {
+        for(int ch = 0; ch < nr_channels; ch++)
+            data.gather(linear_indices(i) + ch*nr_pixels,u_data(ch,i),x_data(ch,i),y_data(ch,i));
+    }
+    // Solve the univariate problem of the stripe
+    mat u_curr, x_curr, y_curr;
+    Solve1DProblem(u_data,x_data,y_data,nr_channels,gamma_s,eta_s,
+                   C_linear,S_linear,C_const,S_const,u_curr,x_curr,y_curr,parallel_dp);
+    // Write back to the splitting variables of direction s
+    for(int i = 0; i < stripe_length; i++) {
+        for(int ch = 0; ch < nr_channels; ch++)
+            data.scatter(linear_indices(i) + ch*nr_pixels,u_curr(ch,i),x_curr(ch,i),y_curr(ch,i));
+    }
+}
+
+// Solves stripe k of the packed layout, which occupies the columns offsets(k),...,offsets(k+1)-1;
+// the solution replaces the data
+static void SolveStripePacked(const StripePlan &plan, const unsigned int k, mat &u_packed, mat &x_packed, mat &y_packed,
+                              double gamma_s, double eta_s, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                              const bool parallel_dp)
+{
+    const int nr_channels = u_packed.n_rows;
+    const uword first = plan.offsets(k);
+    const uword stripe_length = plan.offsets(k+1) - first;
+    mat u_data(u_packed.colptr(first),nr_channels,stripe_length,false,true);
+    mat x_data(x_packed.colptr(first),nr_channels,stripe_length,false,true);
+    mat y_data(y_packed.colptr(first),nr_channels,stripe_length,false,true);
+    mat u_curr, x_curr, y_curr;
+    Solve1DProblem(u_data,x_data,y_data,nr_channels,gamma_s,eta_s,
+                   C_linear,S_linear,C_const,S_const,u_curr,x_curr,y_curr,parallel_dp);
+    u_data = u_curr;
+    x_data = x_curr;
+    y_data = y_curr;
+}
+
+// Tiled pass between image and packed layout: shear/transpose the subproblem data into the packed
+// copy (gather) or shear back the packed solutions to the splitting variables (scatter)
+static void PackedPass(const SubproblemData &data, const StripePlan &plan, const int m, const int n,
+                       mat &u_packed, mat &x_packed, mat &y_packed, const bool gather)
+{
+    const int nr_channels = u_packed.n_rows;
+    const uword nr_pixels = (uword) m*n;
+    const int nr_tiles_m = (m+TILE_ROWS-1)/TILE_ROWS;
+    const int nr_tiles_n = (n+TILE_COLS-1)/TILE_COLS;
+    #pragma omp parallel for schedule(static)
+    for(int tile = 0; tile < nr_tiles_m*nr_tiles_n; tile++) {
+        const int i_0 = (tile % nr_tiles_m)*TILE_ROWS;
+        const int j_0 = (tile / nr_tiles_m)*TILE_COLS;
+        for(int j = j_0; j < min(j_0+TILE_COLS,n); j++) {
+            for(int i = i_0; i < min(i_0+TILE_ROWS,m); i++) {
+                const uword p = i + (uword) j*m;
+                const uword col = plan.positions(p);
+                for(int ch = 0; ch < nr_channels; ch++) {
+                    if (gather)
+                        data.gather(p + ch*nr_pixels,u_packed(ch,col),x_packed(ch,col),y_packed(ch,col));
+                    else
+                        data.scatter(p + ch*nr_pixels,u_packed(ch,col),x_packed(ch,col),y_packed(ch,col));
+                }
+            }
+        }
+    }
+}
+
+// Solves the stripes in place, i.e., gathers each stripe directly from the image
+static bool SolveInPlace(const SubproblemData &data, const StripePlan &plan, const int nr_channels, const uword nr_pixels,
+                         double gamma_s, double eta_s, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                         const Cancellation *cancel)
+{
+    int cancelled = 0;
+    #pragma omp parallel for schedule(runtime)
+    for(unsigned int iter = 0; iter < plan.stripes.size(); ++iter) {
+        if (cancel != NULL && cancel->requested()) {
+            #pragma omp atomic write
+            cancelled = 1;
+            continue;
+        }
+        if (!IsLongStripe(plan,iter))
+            SolveStripeInPlace(data,plan.stripes[iter],nr_channels,nr_pixels,gamma_s,eta_s,
+                               C_linear,S_linear,C_const,S_const,false);
+    }
+    for(unsigned int iter = 0; iter < plan.stripes.size() && !cancelled; ++iter) {
+        if (!IsLongStripe(plan,iter))
+            continue;
+        if (cancel != NULL && cancel->requested())
+            cancelled = 1;
+        else
+            SolveStripeInPlace(data,plan.stripes[iter],nr_channels,nr_pixels,gamma_s,eta_s,
+                               C_linear,S_linear,C_const,S_const,true);
+    }
+    return !cancelled;
+}
+
+// Solves the stripes on the packed layout
+static bool SolvePacked(const SubproblemData &data, const StripePlan &plan, const int m, const int n, const int nr_channels,
+                        double gamma_s, double eta_s, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                        PackedData &packed, const Cancellation *cancel)
+{
+    const uword nr_pixels = (uword) m*n;
+    // No reallocation if the packed copies already have the size (e.g. of the previous direction)
+    packed.u.set_size(nr_channels,nr_pixels);
+    packed.x.set_size(nr_channels,nr_pixels);
+    packed.y.set_size(nr_channels,nr_pixels);
+    mat &u_packed = packed.u;
+    mat &x_packed = packed.x;
+    mat &y_packed = packed.y;
+    PackedPass(data,plan,m,n,u_packed,x_packed,y_packed,true);
+    // Solve the univariate problems on the contiguous stripes
+    int cancelled = 0;
+    #pragma omp parallel for schedule(runtime)
+    for(unsigned int iter = 0; iter < plan.stripes.size(); ++iter) {
+        if (cancel != NULL && cancel->requested()) {
+            #pragma omp atomic write
+            cancelled = 1;
+            continue;
+        }
+        if (!IsLongStripe(plan,iter))
+            SolveStripePacked(plan,iter,u_packed,x_packed,y_packed,gamma_s,eta_s,C_linear,S_linear,C_const,S_const,false);
+    }
+    for(unsigned int iter = 0; iter < plan.stripes.size() && !cancelled; ++iter) {
+        if (!IsLongStripe(plan,iter))
+            continue;
+        if (cancel != NULL && cancel->requested())
+            cancelled = 1;
+        else
+            SolveStripePacked(plan,iter,u_packed,x_packed,y_packed,gamma_s,eta_s,C_linear,S_linear,C_const,S_const,true);
+    }
+    // The packed copy holds data of the skipped stripes, so direction s keeps its previous solution
+    if (cancelled)
+        return false;
+    PackedPass(data,plan,m,n,u_packed,x_packed,y_packed,false);
+    return true;
+}
+
+bool FusedLinewiseSolver(const cube &f, ADMMState &state, const int s, const StripePlan &plan,
+                         double gamma_s, double eta_s,
+                         mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                         PackedData &packed, const Cancellation *cancel)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_channels = f.n_slices;
+    SubproblemData data(f,state,s,state.us[s],state.as[s],state.bs[s]);
+    if (plan.positions.is_empty())
+        return SolveInPlace(data,plan,nr_channels,(uword) m*n,gamma_s,eta_s,C_linear,S_linear,C_const,S_const,cancel);
+    else
+        return SolvePacked(data,plan,m,n,nr_channels,gamma_s,eta_s,C_linear,S_linear,C_const,S_const,packed,cancel);
+}
+
+bool FusedJacobiSolver(const cube &f, const ADMMState &state, const vector<StripePlan> &plans,
+                       const vec &gammas, double eta_s,
+                       mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                       vector<cube> &us_next, vector<cube> &as_next, vector<cube> &bs_next,
+                       vector<PackedData> &packed, const Cancellation *cancel)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_channels = f.n_slices;
+    const uword nr_pixels = (uword) m*n;
+    const int nr_dirs = state.nr_dirs;
+    vector<SubproblemData> data;
+    for(int s = 0; s < nr_dirs; s++)
+        data.push_back(SubproblemData(f,state,s,us_next[s],as_next[s],bs_next[s]));
+    // Packed copies of the subproblem data of all directions with a packed layout (kept by the caller)
+    for(int s = 0; s < nr_dirs; s++) {
+        if (plans[s].positions.is_empty())
+            continue;
+        packed[s].u.set_size(nr_channels,nr_pixels);
+        packed[s].x.set_size(nr_channels,nr_pixels);
+        packed[s].y.set_size(nr_channels,nr_pixels);
+        PackedPass(data[s],plans[s],m,n,packed[s].u,packed[s].x,packed[s].y,true);
+    }
+    // One pool of the stripes of all directions, the long stripes follow one after another
+    vector<int> task_dir, long_dir;
+    vector<unsigned int> task_stripe, long_stripe;
+    for(int s = 0; s < nr_dirs; s++) {
+        for(unsigned int k = 0; k < plans[s].stripes.size(); k++) {
+            if (IsLongStripe(plans[s],k)) {
+                long_dir.push_back(s);
+                long_stripe.push_back(k);
+            } else {
+                task_dir.push_back(s);
+                task_stripe.push_back(k);
+            }
+        }
+    }
+    int cancelled = 0;
+    #pragma omp parallel for schedule(dynamic)
+    for(unsigned int iter = 0; iter < task_dir.size(); ++iter) {
+        if (cancel != NULL && cancel->requested()) {
+            #pragma omp atomic write
+            cancelled = 1;
+            continue;
+        }
+        const int s = task_dir[iter];
+        const unsigned int k = task_stripe[iter];
+        if (plans[s].positions.is_empty())
+            SolveStripeInPlace(data[s],plans[s].stripes[k],nr_channels,nr_pixels,gammas(s),eta_s,
+                               C_linear,S_linear,C_const,S_const,false);
+        else
+            SolveStripePacked(plans[s],k,packed[s].u,packed[s].x,packed[s].y,gammas(s),eta_s,
+                              C_linear,S_linear,C_const,S_const,false);
+    }
+    for(unsigned int iter = 0; iter < long_dir.size() && !cancelled; ++iter) {
+        if (cancel != NULL && cancel->requested()) {
+            cancelled = 1;
+            break;
+        }
+        const int s = long_dir[iter];
+        const unsigned int k = long_stripe[iter];
+        if (plans[s].positions.is_empty())
+            SolveStripeInPlace(data[s],plans[s].stripes[k],nr_channels,nr_pixels,gammas(s),eta_s,
+                               C_linear,S_linear,C_const,S_const,true);
+        else
+            SolveStripePacked(plans[s],k,packed[s].u,packed[s].x,packed[s].y,gammas(s),eta_s,
+                              C_linear,S_linear,C_const,S_const,true);
+    }
+    // The next iterate is incomplete, the caller keeps the previous one
+    if (cancelled)
+        return false;
+    for(int s = 0; s < nr_dirs; s++) {
+        if (!plans[s].positions.is_empty())
+            PackedPass(data[s],plans[s],m,n,packed[s].u,packed[s].x,packed[s].y,false);
+    }
+    return true;
+}
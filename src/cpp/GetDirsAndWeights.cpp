@@ -0,0 +1,33 @@
+/**
+    GetDirsAndWeights.cpp
+    Purpose: Returns the directions of the discrete gradient and the corresponding weights
+             2 directions amount to the anisotropic 4-neighborhood and 4 directions
+             amount to the near-isotropic 8-neighborhood (cf. getDirsAndWeights.m)
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+void GetDirsAndWeights(const int nr_dirs, imat &dirs, vec &omegas)
+{
+    // Directions are stored as columns (x_dir,y_dir)
+    dirs = imat(2,nr_dirs);
+    omegas = vec(nr_dirs);
+    // Axis directions
+    dirs(0,0) = 0; dirs(1,0) = 1;
+    dirs(0,1) = 1; dirs(1,1) = 0;
+    if (nr_dirs == 2) {
+        omegas(0) = 1;
+        omegas(1) = 1;
+        return;
+    }
+    // Diagonal directions
+    dirs(0,2) = 1; dirs(1,2) = 1;
+    dirs(0,3) = 1; dirs(1,3) = -1;
+    omegas(0) = sqrt(2.0)-1;
+    omegas(1) = sqrt(2.0)-1;
+    omegas(2) = 1-sqrt(2.0)/2;
+    omegas(3) = 1-sqrt(2.0)/2;
+}
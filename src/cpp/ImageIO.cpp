@@ -0,0 +1,244 @@
+/**
+    ImageIO.cpp
+    Purpose: Reads PGM/PPM/PFM and raw multichannel images into the solver's memory layout and writes
+             raw results into memory-mapped files (used by the command-line tool)
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "ImageIO.h"
+
+// Skips whitespace and comments of a PNM header
+static const unsigned char* SkipWhitespace(const unsigned char* p, const unsigned char* end)
+{
+    while (p < end) {
+        if (*p == '#') {
+            while (p < end && *p != '\n')
+                p++;
+        } else if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+// Parses an ASCII header token
+static const unsigned char* ParseToken(const unsigned char* p, const unsigned char* end, char* token, size_t max_length)
+{
+    p = SkipWhitespace(p,end);
+    size_t k = 0;
+    while (p < end && k+1 < max_length && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+        token[k++] = *p++;
+    token[k] = '\0';
+    return p;
+}
+
+static bool DecodePNM(const unsigned char* p, const unsigned char* end, const int nr_channels, cube &f)
+{
+    char token[32];
+    p = ParseToken(p,end,token,sizeof(token));
+    const int n = atoi(token);
+    p = ParseToken(p,end,token,sizeof(token));
+    const int m = atoi(token);
+    p = ParseToken(p,end,token,sizeof(token));
+    const int maxval = atoi(token);
+    if (m < 1 || n < 1 || maxval < 1 || maxval > 65535 || p >= end)
+        return false;
+    // A single whitespace character separates header and raster
+    p++;
+    const int bytes = (maxval > 255) ? 2 : 1;
+    if ((size_t)(end-p) < (size_t) m*n*nr_channels*bytes)
+        return false;
+
+    f.set_size(m,n,nr_channels);
+    double* f_raw = f.memptr();
+    const size_t nr_pixels = (size_t) m*n;
+    const double scale = 1.0/maxval;
+    // The raster is stored row by row with interleaved channels
+    for(int i = 0; i < m; i++) {
+        for(int j = 0; j < n; j++) {
+            for(int ch = 0; ch < nr_channels; ch++) {
+                double value;
+                if (bytes == 1) {
+                    value = *p++;
+                } else {
+                    value = (p[0] << 8) | p[1];
+                    p += 2;
+                }
+                f_raw[i + (size_t) j*m + ch*nr_pixels] = scale*value;
+            }
+        }
+    }
+    return true;
+}
+
+static bool DecodePFM(const unsigned char* p, const unsigned char* end, const int nr_channels, cube &f)
+{
+    char token[64];
+    p = ParseToken(p,end,token,sizeof(token));
+    const int n = atoi(token);
+    p = ParseToken(p,end,token,sizeof(token));
+    const int m = atoi(token);
+    p = ParseToken(p,end,token,sizeof(token));
+    const double scale = atof(token);
+    if (m < 1 || n < 1 || scale == 0 || p >= end)
+        return false;
+    p++;
+    if ((size_t)(end-p) < (size_t) m*n*nr_channels*sizeof(float))
+        return false;
+    // A negative scale denotes little-endian data
+    const uint16_t probe = 1;
+    const bool host_little_endian = (*(const unsigned char*) &probe == 1);
+    const bool swap = (scale < 0) != host_little_endian;
+
+    f.set_size(m,n,nr_channels);
+    double* f_raw = f.memptr();
+    const size_t nr_pixels = (size_t) m*n;
+    // The raster is stored row by row from bottom to top with interleaved channels
+    for(int i = m-1; i >= 0; i--) {
+        for(int j = 0; j < n; j++) {
+            for(int ch = 0; ch < nr_channels; ch++) {
+                unsigned char b[4];
+                memcpy(b,p,4);
+                p += 4;
+                if (swap) {
+                    unsigned char t = b[0]; b[0] = b[3]; b[3] = t;
+                    t = b[1]; b[1] = b[2]; b[2] = t;
+                }
+                float value;
+                memcpy(&value,b,4);
+                f_raw[i + (size_t) j*m + ch*nr_pixels] = value;
+            }
+        }
+    }
+    return true;
+}
+
+// Raw float64 image in the format of the output files (any number of channels, e.g. hyperspectral)
+static bool DecodeRaw(const unsigned char* p, const unsigned char* end, cube &f)
+{
+    RawHeader header;
+    memcpy(&header,p,sizeof(header));
+    if (header.dtype != RAW_FLOAT64 || header.m < 1 || header.n < 1 || header.nr_channels < 1)
+        return false;
+    const size_t nr_elem = (size_t) header.m*header.n*header.nr_channels;
+    if ((size_t)(end-p) < sizeof(header) + nr_elem*sizeof(double))
+        return false;
+    f.set_size(header.m,header.n,header.nr_channels);
+    memcpy(f.memptr(),p + sizeof(header),nr_elem*sizeof(double));
+    return true;
+}
+
+bool ReadImage(const char* path, cube &f)
+{
+    // Map the file instead of reading it through buffered streams
+    MappedInput input;
+    if (!input.open(path) || input.getSize() < 3)
+        return false;
+    madvise((void*) input.getData(),input.getSize(),MADV_SEQUENTIAL);
+
+    const unsigned char* p = input.getData();
+    const unsigned char* end = p + input.getSize();
+    if (p[0] == 'P' && p[1] == '5')
+        return DecodePNM(p+2,end,1,f);
+    if (p[0] == 'P' && p[1] == '6')
+        return DecodePNM(p+2,end,3,f);
+    if (p[0] == 'P' && p[1] == 'f')
+        return DecodePFM(p+2,end,1,f);
+    if (p[0] == 'P' && p[1] == 'F')
+        return DecodePFM(p+2,end,3,f);
+    if (input.getSize() >= sizeof(RawHeader) && memcmp(p,"PLMS",4) == 0)
+        return DecodeRaw(p,end,f);
+    return false;
+}
+
+// Getter
+const unsigned char* MappedInput::getData(){
+    return (const unsigned char*) map;
+}
+size_t MappedInput::getSize(){
+    return map_size;
+}
+// Destructor
+MappedInput::~MappedInput(){
+    if (map != NULL)
+        munmap(map,map_size);
+}
+// Constructor
+MappedInput::MappedInput(){
+    map = NULL;
+    map_size = 0;
+}
+
+bool MappedInput::open(const char* path)
+{
+    int fd = ::open(path,O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd,&st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    map = p;
+    map_size = st.st_size;
+    return true;
+}
+
+// Getter
+void* MappedOutput::getData(){
+    return (char*) map + sizeof(RawHeader);
+}
+// Destructor
+MappedOutput::~MappedOutput(){
+    if (map != NULL)
+        munmap(map,map_size);
+}
+// Constructor
+MappedOutput::MappedOutput(){
+    map = NULL;
+    map_size = 0;
+}
+
+bool MappedOutput::create(const char* path, uint32_t dtype, uint32_t m, uint32_t n, uint32_t nr_channels)
+{
+    const size_t elem_size = (dtype == RAW_FLOAT64) ? sizeof(double) : sizeof(int32_t);
+    const size_t size = sizeof(RawHeader) + elem_size*m*n*nr_channels;
+    int fd = open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd,size) != 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    map = p;
+    map_size = size;
+
+    RawHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,"PLMS",4);
+    header.dtype = dtype;
+    header.m = m;
+    header.n = n;
+    header.nr_channels = nr_channels;
+    memcpy(map,&header,sizeof(header));
+    return true;
+}
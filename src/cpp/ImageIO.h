@@ -0,0 +1,61 @@
+#ifndef IMAGEIO_H
+#define IMAGEIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#define ARMA_NO_DEBUG
+#include <armadillo>
+
+using namespace arma;
+
+// Reads an 8/16-bit PGM/PPM (P5/P6, scaled to [0,1]), float PFM (Pf/PF) or raw float64 image (RawHeader,
+// any number of channels) directly into the column-major m x n x nr_channels layout of the solver
+bool ReadImage(const char* path, cube &f);
+
+// Header of the raw output files: column-major data follows the 32 byte header
+struct RawHeader {
+    char magic[4];      // "PLMS"
+    uint32_t dtype;     // RAW_FLOAT64 or RAW_INT32
+    uint32_t m;
+    uint32_t n;
+    uint32_t nr_channels;
+    uint32_t reserved[3];
+};
+enum { RAW_FLOAT64 = 0, RAW_INT32 = 1 };
+
+// Read-only memory-mapped input file
+class MappedInput
+{
+private:
+    void* map;
+    size_t map_size;
+public:
+    // Getter
+    const unsigned char* getData();
+    size_t getSize();
+    // Destructor (unmaps the file)
+    ~MappedInput();
+    // Constructor
+    MappedInput();
+    // Maps the file; returns false on failure
+    bool open(const char* path);
+};
+
+// Raw output file that is memory-mapped, so the solver writes its results directly into the file
+class MappedOutput
+{
+private:
+    void* map;
+    size_t map_size;
+public:
+    // Getter
+    void* getData();
+    // Destructor (unmaps the file)
+    ~MappedOutput();
+    // Constructor
+    MappedOutput();
+    // Creates the file and maps header and data; returns false on failure
+    bool create(const char* path, uint32_t dtype, uint32_t m, uint32_t n, uint32_t nr_channels);
+};
+
+#endif
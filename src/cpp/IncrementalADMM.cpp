@@ -0,0 +1,270 @@
+/**
+    IncrementalADMM.cpp
+    Purpose: Re-solves the ADMM scheme after a local edit of the image, reusing the cached
+             state (splitting variables and multipliers) of a previous solve
+             The ADMM scheme is run on a window around the edited (dirty) region, warm-started
+             from the cached state: outside the dirty region, the splitting variables and multipliers
+             of the window are those of the cached state, and the coupling penalties are rewound to an
+             earlier iteration of the cached solve so that the 1D partitions can adapt to the edit.
+             A window is accepted if its solve converged and agrees with the cached solution on the
+             border band of the window (the influence of the edit has not reached the band); otherwise
+             the window is enlarged. The work of all solves (pixels times iterations) is capped at that
+             of the cached full solve: once the windows have used their share of it, the full image is
+             solved (warm-started as well) with the rest.
+             Only the interior of the accepted window is written back to the cached state.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+// Initial margin between dirty region and window border
+static const int INITIAL_MARGIN = 8;
+// Fraction of the iterations of the cached solve by which its coupling penalties are rewound
+static const double REWIND_FRACTION = 0.75;
+// Share of the work of the cached full solve that may be spent on windows before the full image is solved
+static const double WINDOW_WORK_SHARE = 0.15;
+
+// Axis-aligned window of rows r_0,...,r_1-1 and columns c_0,...,c_1-1
+struct Window {
+    int r_0, r_1, c_0, c_1;
+};
+
+static int BorderDistance(const Window &w, const int m, const int n, const int i, const int j);
+static void InitWindowState(const ADMMState &state, const cube &f_window, const Mat<unsigned char> &dirty,
+                            const Window &w, const int first_iteration, const double mu_nu_step, ADMMState &local);
+static bool BorderAgrees(const ADMMState &state, const cube &u_window, const Window &w,
+                         const int m, const int n, const int band, const double split_tol);
+static void WriteBack(ADMMState &state, const ADMMState &local, const Window &w,
+                      const int m, const int n, const int band);
+
+int IncrementalADMM(const cube &f, const Mat<unsigned char> &dirty, const ADMMParameters &par, ADMMState &state,
+                    cube &u, cube &a, cube &b, cube &c)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_channels = f.n_slices;
+    // Bounding box of the dirty region
+    Window box = {m, 0, n, 0};
+    for(int j = 0; j < n; j++) {
+        for(int i = 0; i < m; i++) {
+            if (dirty(i,j)) {
+                box.r_0 = min(box.r_0,i);
+                box.r_1 = max(box.r_1,i+1);
+                box.c_0 = min(box.c_0,j);
+                box.c_1 = max(box.c_1,j+1);
+            }
+        }
+    }
+    // The time budget holds for all window solves
+    const double start_time = omp_get_wtime();
+    ADMMParameters par_window = par;
+    // Window states are not checkpointed (they would replace the checkpoint of the full image)
+    par_window.checkpoint_path = NULL;
+    state.truncated = false;
+    // Warm start from an earlier iteration of the cached solve (with its penalties, see InitWindowState)
+    const int rewind = (int) ceil(REWIND_FRACTION*state.iteration);
+    const int first_iteration = state.iteration-rewind;
+    // Work (pixels times iterations) of all solves is capped at that of the cached full solve; the windows
+    // may take a share of it, the rest is left for a solve of the full image
+    const double max_work = (double) m*n*max(state.iteration,1);
+    const double max_window_work = WINDOW_WORK_SHARE*max_work;
+    double work = 0;
+    int nr_iterations = 0;
+    int margin = max(INITIAL_MARGIN,max(box.r_1-box.r_0,box.c_1-box.c_0));
+    ADMMState local;
+    Window w = box;
+    while (box.r_0 < box.r_1) {
+        w.r_0 = max(box.r_0-margin,0);
+        w.r_1 = min(box.r_1+margin,m);
+        w.c_0 = max(box.c_0-margin,0);
+        w.c_1 = min(box.c_1+margin,n);
+        bool full_image = (w.r_0 == 0 && w.r_1 == m && w.c_0 == 0 && w.c_1 == n);
+        if (!full_image && work + (double) (w.r_1-w.r_0)*(w.c_1-w.c_0) > max_window_work) {
+            w.r_0 = 0;
+            w.r_1 = m;
+            w.c_0 = 0;
+            w.c_1 = n;
+            full_image = true;
+        }
+        const int m_w = w.r_1-w.r_0;
+        const int n_w = w.c_1-w.c_0;
+        // Iterations of the solve within the remaining work
+        const double remaining = (full_image ? max_work : max_window_work) - work;
+        const int max_solve_iter = (int) min(remaining/((double) m_w*n_w),(double) par.max_iter);
+        // Solve on the window (the slopes are invariant to the shift of the origin)
+        cube f_window(m_w,n_w,nr_channels);
+        for(int ch = 0; ch < nr_channels; ch++) {
+            for(int j = 0; j < n_w; j++) {
+                for(int i = 0; i < m_w; i++)
+                    f_window(i,j,ch) = f(w.r_0+i,w.c_0+j,ch);
+            }
+        }
+        cube u_window(m_w,n_w,nr_channels), a_window(m_w,n_w,nr_channels);
+        cube b_window(m_w,n_w,nr_channels), c_window(m_w,n_w,nr_channels);
+        InitWindowState(state,f_window,dirty,w,first_iteration,par.mu_nu_step,local);
+        par_window.max_iter = first_iteration + max(max_solve_iter,1);
+        if (par.time_budget > 0)
+            par_window.time_budget = max(par.time_budget-(omp_get_wtime()-start_time),1e-9);
+        AffineLinearADMM(f_window,par_window,local,u_window,a_window,b_window,c_window);
+        nr_iterations += local.iteration-first_iteration;
+        work += (double) m_w*n_w*(local.iteration-first_iteration);
+        // A cut short solve is the best available result for the dirty region
+        state.truncated = local.truncated;
+        // A window is accepted if its solve converged and agrees with the cached solution on its border band
+        const bool converged = (local.deviation >= 0 && local.deviation <= par.split_tol);
+        if (full_image || local.truncated || (converged && BorderAgrees(state,u_window,w,m,n,margin/2,par.split_tol))) {
+            if (par.verbose)
+                printf("Incremental solve on %d x %d window\n",m_w,n_w);
+            WriteBack(state,local,w,m,n,full_image ? 0 : margin/2);
+            break;
+        }
+        // The edit influences the border band, enlarge the window
+        margin *= 2;
+    }
+    // Output u,a,b,c
+    ConsensusJetField(state,u,a,b,c);
+    return nr_iterations;
+}
+
+// Auxiliary functions
+
+// Distance of pixel (i,j) to the window borders that are not image borders
+static int BorderDistance(const Window &w, const int m, const int n, const int i, const int j)
+{
+    int dist = max(m,n);
+    if (w.r_0 > 0)
+        dist = min(dist,i-w.r_0);
+    if (w.r_1 < m)
+        dist = min(dist,w.r_1-1-i);
+    if (w.c_0 > 0)
+        dist = min(dist,j-w.c_0);
+    if (w.c_1 < n)
+        dist = min(dist,w.c_1-1-j);
+    return dist;
+}
+
+// Warm start of the window solve: the splitting variables and multipliers of the cached state on the window,
+// except for the dirty pixels, which start from the edited data as in InitADMMState; the penalties are those
+// of iteration first_iteration of the cached solve (from its penalty history; a state without complete history
+// is rewound by the fixed progression mu_nu_step)
+static void InitWindowState(const ADMMState &state, const cube &f_window, const Mat<unsigned char> &dirty,
+                            const Window &w, const int first_iteration, const double mu_nu_step, ADMMState &local)
+{
+    const int nr_dirs = state.nr_dirs;
+    const int m_w = f_window.n_rows;
+    const int n_w = f_window.n_cols;
+    const int nr_channels = f_window.n_slices;
+    InitADMMState(local,f_window,nr_dirs);
+    for(int ch = 0; ch < nr_channels; ch++) {
+        for(int j = 0; j < n_w; j++) {
+            for(int i = 0; i < m_w; i++) {
+                const int i_g = w.r_0+i;
+                const int j_g = w.c_0+j;
+                if (dirty(i_g,j_g))
+                    continue;
+                for(int s = 0; s < nr_dirs; s++) {
+                    local.us[s](i,j,ch) = state.us[s](i_g,j_g,ch);
+                    local.as[s](i,j,ch) = state.as[s](i_g,j_g,ch);
+                    local.bs[s](i,j,ch) = state.bs[s](i_g,j_g,ch);
+                }
+                for(size_t k = 0; k < state.lambdas.size(); k++) {
+                    local.lambdas[k](i,j,ch) = state.lambdas[k](i_g,j_g,ch);
+                    local.taus[k](i,j,ch) = state.taus[k](i_g,j_g,ch);
+                    local.rhos[k](i,j,ch) = state.rhos[k](i_g,j_g,ch);
+                }
+            }
+        }
+    }
+    local.iteration = first_iteration;
+    if (first_iteration == state.iteration) {
+        local.mu = state.mu;
+        local.nu = state.nu;
+        local.mus = state.mus;
+        local.nus = state.nus;
+    } else if (state.mus.size() >= (size_t) state.iteration) {
+        local.mu = state.mus[first_iteration];
+        local.nu = state.nus[first_iteration];
+        local.mus.assign(state.mus.begin(),state.mus.begin()+first_iteration);
+        local.nus.assign(state.nus.begin(),state.nus.begin()+first_iteration);
+    } else {
+        const double rewind_factor = pow(mu_nu_step,state.iteration-first_iteration);
+        local.mu = state.mu/rewind_factor;
+        local.nu = state.nu/rewind_factor;
+    }
+    // The multipliers accumulate steps proportional to the penalties, they are scaled accordingly
+    const double mu_scale = local.mu/state.mu;
+    const double nu_scale = local.nu/state.nu;
+    for(size_t k = 0; k < local.lambdas.size(); k++) {
+        local.lambdas[k] *= mu_scale;
+        local.taus[k] *= nu_scale;
+        local.rhos[k] *= nu_scale;
+    }
+}
+
+// Checks if the window solution deviates from the cached consensus u by at most split_tol
+// (relative) on the border band of the window
+static bool BorderAgrees(const ADMMState &state, const cube &u_window, const Window &w,
+                         const int m, const int n, const int band, const double split_tol)
+{
+    const int nr_dirs = state.nr_dirs;
+    for(int ch = 0; ch < (int) u_window.n_slices; ch++) {
+        for(int j = w.c_0; j < w.c_1; j++) {
+            for(int i = w.r_0; i < w.r_1; i++) {
+                if (BorderDistance(w,m,n,i,j) >= band)
+                    continue;
+                double u_cached = 0;
+                for(int s = 0; s < nr_dirs; s++)
+                    u_cached += state.us[s](i,j,ch);
+                u_cached /= nr_dirs;
+                const double u_new = u_window(i-w.r_0,j-w.c_0,ch);
+                // NaN (0/0) is ignored as in the stopping criterion
+                if (abs(u_new-u_cached)/(abs(u_new)+abs(u_cached)) > split_tol)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Copies the splitting variables and multipliers of the window interior to the cached state; the multipliers
+// are scaled from the penalties of the window solve to those of the cached state (the solve of the full image
+// replaces the penalties instead)
+static void WriteBack(ADMMState &state, const ADMMState &local, const Window &w,
+                      const int m, const int n, const int band)
+{
+    const int nr_dirs = state.nr_dirs;
+    const bool full_image = (w.r_0 == 0 && w.r_1 == m && w.c_0 == 0 && w.c_1 == n);
+    if (full_image) {
+        state.mu = local.mu;
+        state.nu = local.nu;
+        state.iteration = local.iteration;
+        state.deviation = local.deviation;
+        state.penalty_step = local.penalty_step;
+        state.mus = local.mus;
+        state.nus = local.nus;
+    }
+    const double mu_scale = state.mu/local.mu;
+    const double nu_scale = state.nu/local.nu;
+    for(int ch = 0; ch < (int) state.us[0].n_slices; ch++) {
+        for(int j = w.c_0; j < w.c_1; j++) {
+            for(int i = w.r_0; i < w.r_1; i++) {
+                if (BorderDistance(w,m,n,i,j) < band)
+                    continue;
+                const int i_w = i-w.r_0;
+                const int j_w = j-w.c_0;
+                for(int s = 0; s < nr_dirs; s++) {
+                    state.us[s](i,j,ch) = local.us[s](i_w,j_w,ch);
+                    state.as[s](i,j,ch) = local.as[s](i_w,j_w,ch);
+                    state.bs[s](i,j,ch) = local.bs[s](i_w,j_w,ch);
+                }
+                for(size_t k = 0; k < state.lambdas.size(); k++) {
+                    state.lambdas[k](i,j,ch) = mu_scale*local.lambdas[k](i_w,j_w,ch);
+                    state.taus[k](i,j,ch) = nu_scale*local.taus[k](i_w,j_w,ch);
+                    state.rhos[k](i,j,ch) = nu_scale*local.rhos[k](i_w,j_w,ch);
+                }
+            }
+        }
+    }
+}
@@ -1,5 +1,9 @@
 #include "Interval.h"
 
+// Number of channels rotated as one block (from this number of channels on, the interval error is
+// accumulated in CHANNEL_BLOCK independent partial sums)
+static const int CHANNEL_BLOCK = 8;
+
 // Getter
 int Interval::getL(){
     return l;
@@ -10,13 +14,13 @@ int Interval::getR(){
 double Interval::getEps(){
     return eps;
 }
-mat Interval::getUdata(){
+const mat &Interval::getUdata() const{
     return u_data;
 }
-mat Interval::getAdata(){
+const mat &Interval::getAdata() const{
     return a_data;
 }
-mat Interval::getBdata(){
+const mat &Interval::getBdata() const{
     return b_data;
 }
 
@@ -31,7 +35,7 @@ void Interval::setR(int right){
     r = right;
 }
 void Interval::setUdata(mat y){
-    u_data = b_data;
+    u_data = y;
 }
 void Interval::setAdata(mat z){
     a_data = z;
@@ -60,143 +64,115 @@ int Interval::giveLength() const
 {
     return r-l+1;
 }
+// Rotates the new data of channel q into the interval data and returns its squared residual
+static inline double rotateChannel(const double* c, const double* s, const double eta,
+                                   double &u, double &a, double &b,
+                                   const double udata_new, const double adata_new, const double bdata_new)
+{
+    double f_new = eta*udata_new;
+    double x_new = adata_new;
+    double y_new = bdata_new;
+    double hj_old;
+    // Eliminate new row 1
+    hj_old = u;
+    u = c[0]*hj_old + s[0]*f_new;
+    f_new = -s[0]*hj_old + c[0]*f_new;
+    hj_old = a;
+    a = c[1]*hj_old + s[1]*f_new;
+    f_new = -s[1]*hj_old + c[1]*f_new;
+    // Eliminate new row 2
+    hj_old = u;
+    u = c[2]*hj_old + s[2]*x_new;
+    x_new = -s[2]*hj_old + c[2]*x_new;
+    hj_old = a;
+    a = c[3]*hj_old + s[3]*x_new;
+    x_new = -s[3]*hj_old + c[3]*x_new;
+    // Eliminate new row 3 (b data)
+    hj_old = b;
+    b = c[4]*hj_old + s[4]*y_new;
+    y_new = -s[4]*hj_old + c[4]*y_new;
+
+    return (f_new*f_new) + (x_new*x_new) + (y_new*y_new);
+}
+
 // Add data point to the bottom
 void Interval::addBottomDataPoint(const int nr_channels,
         const mat &C_linear, const mat &S_linear,
-        const mat &C_const, const mat &S_const,
-        vec udata_new, vec adata_new, vec bdata_new){
+        const mat &C_const, const mat &S_const, const double eta,
+        const double* udata_new, const double* adata_new, const double* bdata_new){
     
-    double c,s, hj_old, fr_old, xr_old, yj_old,yr_old;
     int h = giveLength(); //h is the current interval length
+    double* u = u_data.colptr(0);
+    double* a = a_data.colptr(0);
+    double* b = b_data.colptr(0);
 
-    // u_data,a_data
     // Handle special case that OLD interval length is 1
     if (h == 1) {
-        c = C_linear(1,0);
-        s = S_linear(1,0);
-        vec f1_old = u_data.col(0);
-        vec x1_old = a_data.col(0);
-        u_data.col(0) = c*f1_old + s*x1_old;
-        a_data.col(0) = -s*f1_old + c*x1_old;
-    }
-    // Eliminate new row 1
-    for(int j=0; j < 2; j++) {
-        c = C_linear(2*h,j);
-        s = S_linear(2*h,j);
-        if (j==0) {
-            for(int q = 0; q < nr_channels; q++) { // Faster than vectorized
-                hj_old = u_data(q,0);
-                fr_old = udata_new(q);
-
-                u_data(q,0) = c*hj_old + s*fr_old;
-                udata_new(q) = -s*hj_old + c*fr_old;
-            }
-        }
-        if (j==1) {
-            for(int q = 0; q < nr_channels; q++) {
-                hj_old = a_data(q,0);
-                fr_old = udata_new(q);
-
-                a_data(q,0) = c*hj_old + s*fr_old;
-                udata_new(q) = -s*hj_old + c*fr_old;
-            }
+        const double c = C_linear(1,0);
+        const double s = S_linear(1,0);
+        for(int q = 0; q < nr_channels; q++) {
+            const double f1_old = u[q];
+            const double x1_old = a[q];
+            u[q] = c*f1_old + s*x1_old;
+            a[q] = -s*f1_old + c*x1_old;
         }
     }
-    // Eliminate new row 2
-    for(int j=0; j < 2; j++) {
-        c = C_linear(2*h+1,j);
-        s = S_linear(2*h+1,j);
-        if (j==0) {
-            for(int q = 0; q < nr_channels; q++) {
-                hj_old = u_data(q,0);
-                xr_old = adata_new(q);
-
-                u_data(q,0) = c*hj_old + s*xr_old;
-                adata_new(q) = -s*hj_old + c*xr_old;
-            }
-        }
-        if(j==1) {
-            for(int q = 0; q < nr_channels; q++) {
-                hj_old = a_data(q,0);
-                xr_old = adata_new(q);
-
-                a_data(q,0) = c*hj_old + s*xr_old;
-                adata_new(q) = -s*hj_old + c*xr_old;
-            }
+    // Look up the Givens rotation coefficients of new rows 1 and 2 (linear data) and 3 (constant data)
+    const double c[5] = {C_linear(2*h,0), C_linear(2*h,1), C_linear(2*h+1,0), C_linear(2*h+1,1), C_const(h,0)};
+    const double s[5] = {S_linear(2*h,0), S_linear(2*h,1), S_linear(2*h+1,0), S_linear(2*h+1,1), S_const(h,0)};
+
+    // Rotate all channels in one pass and update the interval error
+    if (nr_channels < CHANNEL_BLOCK) {
+        for(int q = 0; q < nr_channels; q++)
+            eps += rotateChannel(c,s,eta,u[q],a[q],b[q],udata_new[q],adata_new[q],bdata_new[q]);
+    } else {
+        // Channel blocks with independent partial sums, so that the rotations and the error reduction
+        // of a block are vectorized
+        double partial[CHANNEL_BLOCK] = {0.0};
+        int q = 0;
+        for(; q + CHANNEL_BLOCK <= nr_channels; q += CHANNEL_BLOCK) {
+            for(int k = 0; k < CHANNEL_BLOCK; k++)
+                partial[k] += rotateChannel(c,s,eta,u[q+k],a[q+k],b[q+k],udata_new[q+k],adata_new[q+k],bdata_new[q+k]);
         }
-
-    }
-
-    // b_data
-    // Look up Givens rotation coefficients
-    c = C_const(h,0);
-    s = S_const(h,0);
-    // Eliminate new row 3
-    for(int q = 0; q < nr_channels; q++) {
-        yj_old = b_data(q,0);
-        yr_old = bdata_new(q,0);
-        b_data(q,0) = c*yj_old + s*yr_old;
-        bdata_new(q,0) = -s*yj_old + c*yr_old;
-    }
-
-    // Update interval error, data, length
-    if(h+1 >= 2) { // h is old length
-        for(int q=0; q < nr_channels; q++)
-            eps+= (udata_new(q)*udata_new(q)) + (adata_new(q)*adata_new(q)) + (bdata_new(q)*bdata_new(q));
+        for(; q < nr_channels; q++)
+            partial[0] += rotateChannel(c,s,eta,u[q],a[q],b[q],udata_new[q],adata_new[q],bdata_new[q]);
+        double err = 0.0;
+        for(int k = 0; k < CHANNEL_BLOCK; k++)
+            err += partial[k];
+        eps += err;
     }
 
     r++;
-    if(h < 2) {
-        u_data.col(h) = udata_new;
-        a_data.col(h) = adata_new;
+}
+
+// Rotates the channel columns x and y of interval data by the Givens rotation (c,s)
+static inline void rotateColumns(const int nr_channels, const double c, const double s, double* x, double* y)
+{
+    for(int q = 0; q < nr_channels; q++) {
+        const double x_old = x[q];
+        const double y_old = y[q];
+        x[q] = c*x_old + s*y_old;
+        y[q] = -s*x_old + c*y_old;
     }
 }
 
 // Update associated data i.e. sparse Givens rotate it (in reconstruction process)
 void Interval::givensRotateLinearData(int w, const mat &C_linear, const mat &S_linear){
     
-    double c,s;
+    const int nr_channels = u_data.n_rows;
     // mixed linear constant data
     // Handle first rotation separately
     if(w == 0) {
-        c = C_linear(1,0);
-        s = S_linear(1,0);
-        vec f1_old = u_data.col(0);
-        vec x1_old = a_data.col(0);
-        u_data.col(0) = c*f1_old + s*x1_old;
-        a_data.col(0) = -s*f1_old + c*x1_old;
-
+        rotateColumns(nr_channels,C_linear(1,0),S_linear(1,0),u_data.colptr(0),a_data.colptr(0));
     } else {
         if(w % 2 == 0) {
             // Do f
-            c = C_linear(w,0);
-            s = S_linear(w,0);
-            vec f1_old = u_data.col(0);
-            vec fw_old = u_data.col(w/2);
-            u_data.col(0) = c*f1_old + s*fw_old;
-            u_data.col(w/2) = -s*f1_old + c*fw_old;
-
-            c = C_linear(w,1);
-            s = S_linear(w,1);
-            fw_old = u_data.col(w/2);
-            vec x1_old = a_data.col(0);
-            a_data.col(0) = c*x1_old + s*fw_old;
-            u_data.col(w/2) = -s*x1_old + c*fw_old;
+            rotateColumns(nr_channels,C_linear(w,0),S_linear(w,0),u_data.colptr(0),u_data.colptr(w/2));
+            rotateColumns(nr_channels,C_linear(w,1),S_linear(w,1),a_data.colptr(0),u_data.colptr(w/2));
         } else {
             // Do x
-            c = C_linear(w,0);
-            s = S_linear(w,0);
-            vec f1_old = u_data.col(0);
-            vec xw_old = a_data.col((w-1)/2);
-            u_data.col(0) = c*f1_old + s*xw_old;
-            a_data.col((w-1)/2) = -s*f1_old + c*xw_old;
-
-            c = C_linear(w,1);
-            s = S_linear(w,1);
-            xw_old = a_data.col((w-1)/2);
-            vec x1_old = a_data.col(0);
-            a_data.col(0) = c*x1_old + s*xw_old;
-            a_data.col((w-1)/2) = -s*x1_old + c*xw_old;
+            rotateColumns(nr_channels,C_linear(w,0),S_linear(w,0),u_data.colptr(0),a_data.colptr((w-1)/2));
+            rotateColumns(nr_channels,C_linear(w,1),S_linear(w,1),a_data.colptr(0),a_data.colptr((w-1)/2));
         }
     }
-}
\ No newline at end of file
+}
@@ -19,9 +19,9 @@ public:
     int getL();
     int getR();
     double getEps();
-    mat getUdata();
-    mat getAdata();
-    mat getBdata();
+    const mat &getUdata() const;
+    const mat &getAdata() const;
+    const mat &getBdata() const;
     // Setter:
     void setEps(double e);
     void setL(int left);
@@ -35,11 +35,11 @@ public:
     Interval(int left,int right,const int nr_channels,mat g,mat z,mat w);
     // Give interval / data length
     int giveLength() const;
-    // Add data point to the bottom of the interval
+    // Add data point to the bottom of the interval (the new u data is scaled by eta)
     void addBottomDataPoint(const int nr_channels,
                             const mat &C_linear,const mat &S_linear,
-                            const mat &C_const, const mat &S_const,
-                            vec udata_new, vec adata_new, vec bdata_new);
+                            const mat &C_const, const mat &S_const, const double eta,
+                            const double* udata_new, const double* adata_new, const double* bdata_new);
     // Update associated data i.e. sparse Givens rotate it (for reconstruction process)
     void givensRotateLinearData(int w, const mat &C_linear, const mat &S_linear);
     void givensRotateConstData(int v, mat &C_const, mat &S_const);
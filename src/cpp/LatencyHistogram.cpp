@@ -0,0 +1,77 @@
+/**
+    LatencyHistogram.cpp
+    Purpose: Histogram of request latencies with logarithmic buckets (solver daemon and its client)
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "LatencyHistogram.h"
+
+// Number of buckets, the last one ends at 2^(NR_BUCKETS-1) microseconds (about 76 hours)
+static const int NR_BUCKETS = 39;
+
+// Getter
+const std::string &LatencyHistogram::getName() const{
+    return name;
+}
+size_t LatencyHistogram::getCount() const{
+    return count;
+}
+
+// Constructor
+LatencyHistogram::LatencyHistogram(const char* name) : name(name), counts(NR_BUCKETS,0)
+{
+    count = 0;
+    sum = 0;
+    max_seconds = 0;
+}
+
+// Upper bound of bucket k in seconds
+static double BucketBound(const int k)
+{
+    return ldexp(1e-6,k);
+}
+
+void LatencyHistogram::record(const double seconds)
+{
+    int k = 0;
+    while (k+1 < NR_BUCKETS && seconds >= BucketBound(k))
+        k++;
+    counts[k]++;
+    count++;
+    sum += seconds;
+    max_seconds = std::max(max_seconds,seconds);
+}
+
+double LatencyHistogram::quantile(const double p) const
+{
+    if (count == 0)
+        return 0;
+    const double rank = p*count;
+    size_t cumulated = 0;
+    for(int k = 0; k < NR_BUCKETS; k++) {
+        cumulated += counts[k];
+        if (cumulated >= rank)
+            return std::min(BucketBound(k),max_seconds);
+    }
+    return max_seconds;
+}
+
+void LatencyHistogram::report(std::string &out) const
+{
+    char line[160];
+    snprintf(line,sizeof(line),"%s: %zu requests, mean %.3f ms, p50 <= %.3f ms, p90 <= %.3f ms, p99 <= %.3f ms, "
+             "max %.3f ms\n",name.c_str(),count,(count > 0) ? 1e3*sum/count : 0.0,1e3*quantile(0.5),
+             1e3*quantile(0.9),1e3*quantile(0.99),1e3*max_seconds);
+    out += line;
+    for(int k = 0; k < NR_BUCKETS; k++) {
+        if (counts[k] == 0)
+            continue;
+        snprintf(line,sizeof(line),"  < %12.3f ms: %zu\n",1e3*BucketBound(k),counts[k]);
+        out += line;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <string>
+#include <vector>
+
+// Histogram of latencies with logarithmic buckets: bucket k > 0 counts latencies in [2^(k-1), 2^k)
+// microseconds, bucket 0 those below one microsecond
+class LatencyHistogram
+{
+private:
+    std::string name;
+    std::vector<size_t> counts;
+    size_t count;
+    double sum;
+    double max_seconds;
+public:
+    // Getter
+    const std::string &getName() const;
+    size_t getCount() const;
+    // Constructor
+    LatencyHistogram(const char* name);
+    // Adds a latency
+    void record(const double seconds);
+    // Upper bound (in seconds) of the bucket of the p-quantile, 0 < p <= 1
+    double quantile(const double p) const;
+    // Appends count, mean, quantiles, max and the non-empty buckets as text
+    void report(std::string &out) const;
+};
+
+#endif
@@ -28,36 +28,12 @@ void LinewisePartitioning(cube &u_out,cube &a_out,cube &b_out,
         Stripe &stripe_udata     = L_udata[iter];
         Stripe &stripe_adata     = L_adata[iter];
         Stripe &stripe_bdata     = L_bdata[iter];
-        // Length of current 1D-problem
-        int stripe_length = stripe_udata.giveLength();
         // Linear indices of current stripe within 2D domain
         uvec linear_indices = stripe_udata.getIndices();
-        // Catch stripes of length 1
-        if(stripe_length < 2) {
-            u_out.elem(linear_indices) = stripe_udata.getData().t();
-            a_out.elem(linear_indices) = stripe_adata.getData().t();
-            b_out.elem(linear_indices) = stripe_bdata.getData().t();
-            continue;
-        }
-
-        // The 1D partition is encoded by the vector L
-        ivec L(stripe_length);
-
-        // [1,r]-errors
-        vec Eps1R = Compute1rErrors(eta_s*stripe_udata.getData(),stripe_adata.getData(),stripe_bdata.getData(),
-                                           nr_channels,C_linear,S_linear,C_const,S_const);
-        // Find optimal 1D partition
-        FindBest1DPartition(stripe_udata.getData(),stripe_adata.getData(),stripe_bdata.getData(),stripe_length,
-                                     nr_channels,gamma_s,eta_s,Eps1R,C_linear,S_linear,C_const,S_const,L);
-
-
-        // Get solution from partition and assign to stripe
-        mat a_curr = zeros(nr_channels, stripe_length);
-        mat b_curr = zeros(nr_channels, stripe_length);
-        mat u_curr = zeros(nr_channels, stripe_length);
-        ReconstructionFromPartition(L,stripe_udata.getData(),stripe_adata.getData(),stripe_bdata.getData(),
-                         stripe_length,nr_channels,eta_s,C_linear,S_linear,u_curr,a_curr,b_curr);
-
+        // Solve the univariate problem of the stripe
+        mat u_curr, a_curr, b_curr;
+        Solve1DProblem(stripe_udata.getData(),stripe_adata.getData(),stripe_bdata.getData(),nr_channels,
+                       gamma_s,eta_s,C_linear,S_linear,C_const,S_const,u_curr,a_curr,b_curr);
 
         // Assign stripe to 2D outputs
         u_out.elem(linear_indices) = u_curr.t();
@@ -66,3 +42,38 @@ void LinewisePartitioning(cube &u_out,cube &a_out,cube &b_out,
     }
 }
 
+void Solve1DProblem(const mat &u_data, const mat &a_data, const mat &b_data, const int nr_channels,
+                    double gamma_s, double eta_s, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                    mat &u_out, mat &a_out, mat &b_out, const bool parallel_dp)
+{
+    // Length of current 1D-problem
+    int stripe_length = u_data.n_cols;
+    // Catch stripes of length 1
+    if(stripe_length < 2) {
+        u_out = u_data;
+        a_out = a_data;
+        b_out = b_data;
+        return;
+    }
+
+    // The 1D partition is encoded by the vector L
+    ivec L(stripe_length);
+
+    // [1,r]-errors
+    vec Eps1R = Compute1rErrors(eta_s*u_data,a_data,b_data,
+                                nr_channels,C_linear,S_linear,C_const,S_const);
+    // Find optimal 1D partition
+    if (parallel_dp)
+        FindBest1DPartitionParallel(u_data,a_data,b_data,stripe_length,
+                                    nr_channels,gamma_s,eta_s,Eps1R,C_linear,S_linear,C_const,S_const,L);
+    else
+        FindBest1DPartition(u_data,a_data,b_data,stripe_length,
+                            nr_channels,gamma_s,eta_s,Eps1R,C_linear,S_linear,C_const,S_const,L);
+
+    // Get solution from partition
+    a_out = zeros(nr_channels, stripe_length);
+    b_out = zeros(nr_channels, stripe_length);
+    u_out = zeros(nr_channels, stripe_length);
+    ReconstructionFromPartition(L,u_data,a_data,b_data,
+                                stripe_length,nr_channels,eta_s,C_linear,S_linear,u_out,a_out,b_out);
+}
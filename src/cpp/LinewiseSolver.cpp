@@ -0,0 +1,166 @@
+/**
+    LinewiseSolver.cpp
+    Purpose: Reference for FusedLinewiseSolver (cf. LinewiseSolver.m): computes the subproblem data of
+             the s-th direction as full cubes, transforms the slope data according to the direction,
+             calls the linewise partitioning and back transforms the slopes
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+static void ComputeLinewiseData(const cube &f, const ADMMState &state, const int s,
+                                cube &us_data, cube &as_data, cube &bs_data);
+static double MaxDeviation(const cube &x, const cube &y);
+
+void LinewiseSolver(const cube &f, const ADMMState &state, const int s, double gamma_s, double eta_s,
+                    mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                    cube &u_s, cube &a_s, cube &b_s)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_channels = f.n_slices;
+    cube us_data, as_data, bs_data;
+    ComputeLinewiseData(f,state,s,us_data,as_data,bs_data);
+    // Transform slope data according to the s-th direction
+    cube x_slope_data, y_slope_data;
+    switch (s) {
+        case 0:
+            x_slope_data = bs_data;
+            y_slope_data = as_data;
+            break;
+        case 1:
+            x_slope_data = as_data;
+            y_slope_data = bs_data;
+            break;
+        case 2:
+            x_slope_data = as_data + bs_data;
+            y_slope_data = as_data - bs_data;
+            break;
+        case 3:
+            x_slope_data = as_data - bs_data;
+            y_slope_data = as_data + bs_data;
+            break;
+    }
+    // Get current direction
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(state.nr_dirs,dirs,omegas);
+    vec dir_s(2);
+    dir_s(0) = dirs(0,s);
+    dir_s(1) = dirs(1,s);
+    // Call the linewise solver
+    cube x(m,n,nr_channels), y(m,n,nr_channels);
+    u_s.set_size(m,n,nr_channels);
+    LinewisePartitioning(u_s,x,y,m,n,nr_channels,us_data,x_slope_data,y_slope_data,dir_s,gamma_s,eta_s,
+                         C_linear,S_linear,C_const,S_const);
+    // Back transform the slopes x and y to a_s and b_s
+    switch (s) {
+        case 0:
+            a_s = y;
+            b_s = x;
+            break;
+        case 1:
+            a_s = x;
+            b_s = y;
+            break;
+        case 2:
+            a_s = (x+y)/2;
+            b_s = (x-y)/2;
+            break;
+        case 3:
+            a_s = (x+y)/2;
+            b_s = (y-x)/2;
+            break;
+    }
+}
+
+double FusedSolverDeviation(const cube &f, const ADMMState &state, const double gamma)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_dirs = state.nr_dirs;
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(nr_dirs,dirs,omegas);
+    // Data weight and Givens rotation angles of the current penalties (as in AffineLinearADMM)
+    const double eta = sqrt((2+state.mu*nr_dirs*(nr_dirs-1))/(state.nu*nr_dirs*(nr_dirs-1)));
+    mat C_linear, S_linear, C_const, S_const;
+    CalcGivensAngles(max(m,n),eta,C_linear,S_linear,C_const,S_const);
+    double deviation = 0;
+    for(int s = 0; s < nr_dirs; s++) {
+        const double gamma_s = (2*omegas(s)*gamma) / ((nr_dirs-1)*state.nu);
+        vec dir_s(2);
+        dir_s(0) = dirs(0,s);
+        dir_s(1) = dirs(1,s);
+        StripePlan plan;
+        CreateStripePlan(dir_s,m,n,false,0,plan);
+        PackedData packed;
+        ADMMState fused = state;
+        FusedLinewiseSolver(f,fused,s,plan,gamma_s,eta,C_linear,S_linear,C_const,S_const,packed);
+        cube u_s, a_s, b_s;
+        LinewiseSolver(f,state,s,gamma_s,eta,C_linear,S_linear,C_const,S_const,u_s,a_s,b_s);
+        deviation = max(deviation,MaxDeviation(fused.us[s],u_s));
+        deviation = max(deviation,MaxDeviation(fused.as[s],a_s));
+        deviation = max(deviation,MaxDeviation(fused.bs[s],b_s));
+    }
+    return deviation;
+}
+
+// Auxiliary functions
+
+// Computes the data for the subproblems as in the lines 6-8 of Algorithm 1
+static void ComputeLinewiseData(const cube &f, const ADMMState &state, const int s,
+                                cube &us_data, cube &as_data, cube &bs_data)
+{
+    const int nr_dirs = state.nr_dirs;
+    const double mu = state.mu;
+    const double nu = state.nu;
+    const uword nr_elem = f.n_elem;
+
+    us_data.zeros(f.n_rows,f.n_cols,f.n_slices);
+    as_data.zeros(f.n_rows,f.n_cols,f.n_slices);
+    bs_data.zeros(f.n_rows,f.n_cols,f.n_slices);
+    double* w_s = us_data.memptr();
+    double* y_s = as_data.memptr();
+    double* z_s = bs_data.memptr();
+    for(int t = 0; t < nr_dirs; t++) {
+        if (t == s)
+            continue;
+        // Already updated splitting variables enter with +, not yet updated ones with -
+        const double sign = (t < s) ? 1 : -1;
+        const int k = (t < s) ? PairIndex(t,s,nr_dirs) : PairIndex(s,t,nr_dirs);
+        const double* u_t = state.us[t].memptr();
+        const double* a_t = state.as[t].memptr();
+        const double* b_t = state.bs[t].memptr();
+        const double* lambda = state.lambdas[k].memptr();
+        const double* tau = state.taus[k].memptr();
+        const double* rho = state.rhos[k].memptr();
+        for(uword i = 0; i < nr_elem; i++) {
+            w_s[i] += u_t[i] + sign*lambda[i]/mu;
+            y_s[i] += a_t[i] + sign*tau[i]/nu;
+            z_s[i] += b_t[i] + sign*rho[i]/nu;
+        }
+    }
+    // Gather the above
+    const double* f_raw = f.memptr();
+    for(uword i = 0; i < nr_elem; i++) {
+        // Offset data
+        w_s[i] = (2*f_raw[i] + mu*nr_dirs*w_s[i]) / (2+mu*nr_dirs*(nr_dirs-1));
+        // Slope data
+        y_s[i] = y_s[i]/(nr_dirs-1);
+        z_s[i] = z_s[i]/(nr_dirs-1);
+    }
+}
+
+// Max absolute deviation between two cubes of the same size
+static double MaxDeviation(const cube &x, const cube &y)
+{
+    double dev = 0;
+    const double* x_raw = x.memptr();
+    const double* y_raw = y.memptr();
+    for(uword i = 0; i < x.n_elem; i++)
+        dev = max(dev,abs(x_raw[i]-y_raw[i]));
+    return dev;
+}
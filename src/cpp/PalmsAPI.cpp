@@ -0,0 +1,466 @@
+/**
+    PalmsAPI.cpp
+    Purpose: Implementation of the stable C interface of the standalone PALMS library
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include "linewiseAffineMS.h"
+#include "Autotuner.h"
+#include "Checkpoint.h"
+#include "PalmsAPI.h"
+#include "SegmentEncoding.h"
+#include "SolverCache.h"
+
+struct palms_cache {
+    SolverCache cache;
+};
+
+int palms_api_version(void)
+{
+    return PALMS_API_VERSION;
+}
+
+// Size of the parameters of API version 1, the prefix of all later versions
+static const size_t PARAMETERS_V1_SIZE = offsetof(palms_parameters,verbose) + sizeof(int);
+
+// Fills all fields of par with the defaults (par has the size of the current struct)
+static void DefaultParameters(palms_parameters *par)
+{
+    ADMMParameters defaults;
+    memset(par,0,sizeof(palms_parameters));
+    par->struct_size = sizeof(palms_parameters);
+    par->gamma = defaults.gamma;
+    par->max_iter = defaults.max_iter;
+    par->mu_nu_step = defaults.mu_nu_step;
+    par->isotropic = 1;
+    par->split_tol = defaults.split_tol;
+    par->nr_threads = defaults.nr_threads;
+    par->verbose = defaults.verbose;
+    par->packed_layout = defaults.packed_layout;
+    par->time_budget = defaults.time_budget;
+    par->cancel = defaults.cancel;
+    par->jacobi = defaults.jacobi;
+    par->long_stripe_length = defaults.long_stripe_length;
+    par->tuning_profile = defaults.tuning_profile;
+    par->adaptive_penalties = defaults.adaptive_penalties;
+    par->checkpoint_path = defaults.checkpoint_path;
+    par->checkpoint_interval = defaults.checkpoint_interval;
+    par->checkpoint_float32 = defaults.checkpoint_float32;
+    par->compress_channels = defaults.compress_channels;
+    par->cache = NULL;
+    par->deviation = NULL;
+}
+
+void palms_default_parameters_sized(palms_parameters *par, size_t size)
+{
+    if (par == NULL || size < offsetof(palms_parameters,gamma))
+        return;
+    palms_parameters defaults;
+    DefaultParameters(&defaults);
+    size = min(size,sizeof(palms_parameters));
+    defaults.struct_size = size;
+    memcpy(par,&defaults,size);
+}
+
+// The header maps palms_default_parameters to the sized variant; this is the entry point of older binaries
+#undef palms_default_parameters
+void palms_default_parameters(palms_parameters *par)
+{
+    palms_default_parameters_sized(par,PARAMETERS_V1_SIZE);
+}
+
+// Copies the caller's parameters onto the defaults (callers compiled against an older header pass a smaller struct)
+static palms_status ConvertParameters(const palms_parameters *par_in, ADMMParameters &par)
+{
+    palms_parameters p;
+    DefaultParameters(&p);
+    if (par_in != NULL) {
+        if (par_in->struct_size < offsetof(palms_parameters,gamma) || par_in->struct_size > sizeof(palms_parameters))
+            return PALMS_ERROR_INVALID_ARGUMENT;
+        memcpy(&p,par_in,par_in->struct_size);
+    }
+    // Check input arguments (cf. affineLinearPartitioning.m)
+    if (!(p.gamma > 0) || !(p.mu_nu_step > 1) || p.max_iter <= 1 || !(p.split_tol > 0) || p.nr_threads <= 0)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    par.gamma = p.gamma;
+    par.nr_dirs = (p.isotropic == 0) ? 2 : 4;
+    par.max_iter = p.max_iter;
+    par.mu_nu_step = p.mu_nu_step;
+    par.split_tol = p.split_tol;
+    par.nr_threads = p.nr_threads;
+    par.verbose = (p.verbose != 0);
+    par.packed_layout = (p.packed_layout != 0);
+    par.time_budget = p.time_budget;
+    par.cancel = p.cancel;
+    par.jacobi = (p.jacobi != 0);
+    par.long_stripe_length = p.long_stripe_length;
+    par.tuning_profile = p.tuning_profile;
+    par.adaptive_penalties = (p.adaptive_penalties != 0);
+    par.checkpoint_path = p.checkpoint_path;
+    par.checkpoint_interval = p.checkpoint_interval;
+    par.checkpoint_float32 = (p.checkpoint_float32 != 0);
+    par.compress_channels = (p.compress_channels != 0);
+    par.cache = (p.cache != NULL) ? &p.cache->cache : NULL;
+    return PALMS_OK;
+}
+
+// Output of the splitting deviation (NULL if it is not set or the caller's struct predates it)
+static double *DeviationOutput(const palms_parameters *par_in)
+{
+    if (par_in == NULL || par_in->struct_size < offsetof(palms_parameters,deviation) + sizeof(double*))
+        return NULL;
+    return par_in->deviation;
+}
+
+// Returns the caller's output memory or, if it is not provided, the memory of tmp
+static double *OutputMemory(double *out, vector<double> &tmp, const size_t nr_elem)
+{
+    if (out != NULL)
+        return out;
+    tmp.resize(nr_elem);
+    return tmp.data();
+}
+
+// Solve from scratch (resume_path == NULL) or from the state of a checkpoint
+static palms_status Partition(const double *f, int m, int n, int nr_channels,
+                              const palms_parameters *par_in, const char *resume_path,
+                              double *u, double *a, double *b, double *c,
+                              int *partition, int *nr_iterations)
+{
+    if (f == NULL || m < 1 || n < 1 || nr_channels < 1)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    ADMMParameters par;
+    palms_status status = ConvertParameters(par_in,par);
+    if (status != PALMS_OK)
+        return status;
+    try {
+        // The input is only read, hence its memory is used directly
+        const cube f_cube(const_cast<double*>(f),m,n,nr_channels,false,true);
+        // Outputs are written directly into the caller's memory; missing ones are allocated
+        const size_t nr_elem = (size_t) m*n*nr_channels;
+        vector<double> u_tmp, a_tmp, b_tmp, c_tmp;
+        cube u_out(OutputMemory(u,u_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube a_out(OutputMemory(a,a_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube b_out(OutputMemory(b,b_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube c_out(OutputMemory(c,c_tmp,nr_elem),m,n,nr_channels,false,true);
+
+        // With channel compression, the solve runs on the coordinates of f w.r.t. an orthonormal basis
+        // of its channel span (a checkpoint then holds the state of the compressed solve)
+        mat basis;
+        if (par.compress_channels && nr_channels > 1)
+            basis = ChannelBasis(f_cube);
+        const bool compressed = (basis.n_cols > 0 && basis.n_cols < (uword) nr_channels);
+        cube f_compressed, u_compressed, a_compressed, b_compressed, c_compressed;
+        if (compressed) {
+            CompressChannels(f_cube,basis,f_compressed);
+            u_compressed.set_size(m,n,basis.n_cols);
+            a_compressed.set_size(m,n,basis.n_cols);
+            b_compressed.set_size(m,n,basis.n_cols);
+            c_compressed.set_size(m,n,basis.n_cols);
+            if (par.verbose)
+                printf("Channels compressed from %d to %d\n",nr_channels,(int) basis.n_cols);
+        }
+        const cube &f_solve = compressed ? f_compressed : f_cube;
+
+        ADMMState own_state;
+        ADMMState &state = (par.cache != NULL) ? par.cache->workspace(m,n,f_solve.n_slices,par.nr_dirs) : own_state;
+        if (resume_path == NULL) {
+            InitADMMState(state,f_solve,par.nr_dirs);
+        } else if (!ReadCheckpoint(resume_path,f_solve,par,state)) {
+            return PALMS_ERROR_CHECKPOINT;
+        }
+        int iterations;
+        if (compressed) {
+            iterations = AffineLinearADMM(f_solve,par,state,u_compressed,a_compressed,b_compressed,c_compressed);
+            ExpandChannels(u_compressed,basis,u_out);
+            ExpandChannels(a_compressed,basis,a_out);
+            ExpandChannels(b_compressed,basis,b_out);
+            ExpandChannels(c_compressed,basis,c_out);
+        } else {
+            iterations = AffineLinearADMM(f_solve,par,state,u_out,a_out,b_out,c_out);
+        }
+        if (nr_iterations != NULL)
+            *nr_iterations = iterations;
+        double *deviation = DeviationOutput(par_in);
+        if (deviation != NULL)
+            *deviation = state.deviation;
+
+        if (partition != NULL) {
+            Mat<int> partition_out(partition,m,n,false,true);
+            PartitioningFromJetField(a_out,b_out,c_out,partition_out);
+        }
+        if (state.truncated)
+            return PALMS_TRUNCATED;
+    } catch (const std::bad_alloc &) {
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        return PALMS_ERROR_INTERNAL;
+    }
+    return PALMS_OK;
+}
+
+palms_status palms_partition(const double *f, int m, int n, int nr_channels,
+                             const palms_parameters *par,
+                             double *u, double *a, double *b, double *c,
+                             int *partition, int *nr_iterations)
+{
+    return Partition(f,m,n,nr_channels,par,NULL,u,a,b,c,partition,nr_iterations);
+}
+
+palms_status palms_resume(const char *checkpoint_path, const double *f, int m, int n, int nr_channels,
+                          const palms_parameters *par,
+                          double *u, double *a, double *b, double *c,
+                          int *partition, int *nr_iterations)
+{
+    if (checkpoint_path == NULL)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    return Partition(f,m,n,nr_channels,par,checkpoint_path,u,a,b,c,partition,nr_iterations);
+}
+
+palms_status palms_autotune(int m, int n, int nr_channels, const palms_parameters *par_in)
+{
+    if (m < 1 || n < 1 || nr_channels < 1)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    ADMMParameters par;
+    palms_status status = ConvertParameters(par_in,par);
+    if (status != PALMS_OK)
+        return status;
+    if (par.tuning_profile == NULL)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    try {
+        if (!Autotune(m,n,nr_channels,par))
+            return PALMS_ERROR_INTERNAL;
+    } catch (const std::bad_alloc &) {
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        return PALMS_ERROR_INTERNAL;
+    }
+    return PALMS_OK;
+}
+
+palms_cache *palms_cache_create(void)
+{
+    return new (std::nothrow) palms_cache;
+}
+
+void palms_cache_destroy(palms_cache *cache)
+{
+    delete cache;
+}
+
+void palms_cache_stats(const palms_cache *cache, size_t *hits, size_t *misses)
+{
+    if (hits != NULL)
+        *hits = (cache != NULL) ? cache->cache.getHits() : 0;
+    if (misses != NULL)
+        *misses = (cache != NULL) ? cache->cache.getMisses() : 0;
+}
+
+struct palms_solver {
+    int m, n, nr_channels;
+    ADMMParameters par;
+    std::string tuning_profile;     // Copy of the caller's profile path
+    std::string checkpoint_path;    // Copy of the caller's checkpoint path
+    cube f;
+    ADMMState state;
+    bool has_state;
+};
+
+palms_status palms_solver_create(int m, int n, int nr_channels, const palms_parameters *par_in,
+                                 palms_solver **solver)
+{
+    if (solver == NULL || m < 1 || n < 1 || nr_channels < 1)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    ADMMParameters par;
+    palms_status status = ConvertParameters(par_in,par);
+    if (status != PALMS_OK)
+        return status;
+    palms_solver *s = new (std::nothrow) palms_solver;
+    if (s == NULL)
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    s->m = m;
+    s->n = n;
+    s->nr_channels = nr_channels;
+    s->par = par;
+    if (par.tuning_profile != NULL) {
+        s->tuning_profile = par.tuning_profile;
+        s->par.tuning_profile = s->tuning_profile.c_str();
+    }
+    if (par.checkpoint_path != NULL) {
+        s->checkpoint_path = par.checkpoint_path;
+        s->par.checkpoint_path = s->checkpoint_path.c_str();
+    }
+    s->has_state = false;
+    *solver = s;
+    return PALMS_OK;
+}
+
+void palms_solver_destroy(palms_solver *solver)
+{
+    delete solver;
+}
+
+// Full (dirty == NULL) or incremental solve of the solver's image
+static palms_status SolverRun(palms_solver *solver, const double *f, const Mat<unsigned char> *dirty,
+                              double *u, double *a, double *b, double *c,
+                              int *partition, int *nr_iterations)
+{
+    if (solver == NULL || f == NULL)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    const int m = solver->m;
+    const int n = solver->n;
+    const int nr_channels = solver->nr_channels;
+    try {
+        // The image is copied, it has to outlive the call for later updates
+        solver->f = cube(const_cast<double*>(f),m,n,nr_channels,true,false);
+        const size_t nr_elem = (size_t) m*n*nr_channels;
+        vector<double> u_tmp, a_tmp, b_tmp, c_tmp;
+        cube u_out(OutputMemory(u,u_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube a_out(OutputMemory(a,a_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube b_out(OutputMemory(b,b_tmp,nr_elem),m,n,nr_channels,false,true);
+        cube c_out(OutputMemory(c,c_tmp,nr_elem),m,n,nr_channels,false,true);
+
+        int iterations;
+        if (dirty != NULL && solver->has_state) {
+            iterations = IncrementalADMM(solver->f,*dirty,solver->par,solver->state,u_out,a_out,b_out,c_out);
+        } else {
+            // The state is invalid while it is being computed
+            solver->has_state = false;
+            InitADMMState(solver->state,solver->f,solver->par.nr_dirs);
+            iterations = AffineLinearADMM(solver->f,solver->par,solver->state,u_out,a_out,b_out,c_out);
+            solver->has_state = true;
+        }
+        // A cut short state does not serve as cache of a converged solve
+        if (solver->state.truncated)
+            solver->has_state = false;
+        if (nr_iterations != NULL)
+            *nr_iterations = iterations;
+
+        if (partition != NULL) {
+            Mat<int> partition_out(partition,m,n,false,true);
+            PartitioningFromJetField(a_out,b_out,c_out,partition_out);
+        }
+        if (solver->state.truncated)
+            return PALMS_TRUNCATED;
+    } catch (const std::bad_alloc &) {
+        solver->has_state = false;
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        solver->has_state = false;
+        return PALMS_ERROR_INTERNAL;
+    }
+    return PALMS_OK;
+}
+
+palms_status palms_solver_solve(palms_solver *solver, const double *f,
+                                double *u, double *a, double *b, double *c,
+                                int *partition, int *nr_iterations)
+{
+    return SolverRun(solver,f,NULL,u,a,b,c,partition,nr_iterations);
+}
+
+palms_status palms_solver_update(palms_solver *solver, const double *f, const unsigned char *dirty,
+                                 double *u, double *a, double *b, double *c,
+                                 int *partition, int *nr_iterations)
+{
+    if (solver == NULL || dirty == NULL)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    try {
+        const Mat<unsigned char> dirty_in(const_cast<unsigned char*>(dirty),solver->m,solver->n,false,true);
+        return SolverRun(solver,f,&dirty_in,u,a,b,c,partition,nr_iterations);
+    } catch (const std::exception &) {
+        return PALMS_ERROR_INTERNAL;
+    }
+}
+
+palms_status palms_solver_update_rect(palms_solver *solver, const double *f,
+                                      int row, int col, int height, int width,
+                                      double *u, double *a, double *b, double *c,
+                                      int *partition, int *nr_iterations)
+{
+    if (solver == NULL || height < 0 || width < 0)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    try {
+        Mat<unsigned char> dirty(solver->m,solver->n);
+        dirty.zeros();
+        for(int j = max(col,0); j < min(col+width,solver->n); j++) {
+            for(int i = max(row,0); i < min(row+height,solver->m); i++)
+                dirty(i,j) = 1;
+        }
+        return SolverRun(solver,f,&dirty,u,a,b,c,partition,nr_iterations);
+    } catch (const std::bad_alloc &) {
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        return PALMS_ERROR_INTERNAL;
+    }
+}
+
+palms_status palms_encode_segments(const int *partition, const double *a, const double *b, const double *c,
+                                   int m, int n, int nr_channels, palms_write_fn write, void *user)
+{
+    if (partition == NULL || a == NULL || b == NULL || c == NULL || write == NULL ||
+        m < 1 || n < 1 || nr_channels < 1)
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    try {
+        const Mat<int> partition_in(const_cast<int*>(partition),m,n,false,true);
+        const cube a_in(const_cast<double*>(a),m,n,nr_channels,false,true);
+        const cube b_in(const_cast<double*>(b),m,n,nr_channels,false,true);
+        const cube c_in(const_cast<double*>(c),m,n,nr_channels,false,true);
+        if (!EncodeSegments(partition_in,a_in,b_in,c_in,write,user))
+            return PALMS_ERROR_INVALID_ARGUMENT;
+    } catch (const std::bad_alloc &) {
+        return PALMS_ERROR_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        return PALMS_ERROR_INTERNAL;
+    }
+    return PALMS_OK;
+}
+
+palms_status palms_segments_info(const void *data, size_t size,
+                                 int *m, int *n, int *nr_channels, int *nr_segments)
+{
+    SegmentFileHeader header;
+    if (data == NULL || !ReadSegmentHeader((const unsigned char*) data,size,header))
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    if (m != NULL)
+        *m = header.m;
+    if (n != NULL)
+        *n = header.n;
+    if (nr_channels != NULL)
+        *nr_channels = header.nr_channels;
+    if (nr_segments != NULL)
+        *nr_segments = header.nr_segments;
+    return PALMS_OK;
+}
+
+palms_status palms_rasterize_segments(const void *data, size_t size, double *u, int *partition)
+{
+    if (data == NULL || !RasterizeSegments((const unsigned char*) data,size,u,partition))
+        return PALMS_ERROR_INVALID_ARGUMENT;
+    return PALMS_OK;
+}
+
+const char *palms_status_string(palms_status status)
+{
+    switch (status) {
+        case PALMS_OK:
+            return "success";
+        case PALMS_ERROR_INVALID_ARGUMENT:
+            return "invalid argument";
+        case PALMS_ERROR_OUT_OF_MEMORY:
+            return "out of memory";
+        case PALMS_ERROR_INTERNAL:
+            return "internal error";
+        case PALMS_TRUNCATED:
+            return "solve cut short";
+        case PALMS_ERROR_CHECKPOINT:
+            return "checkpoint cannot be read or does not belong to the image and parameters";
+    }
+    return "unknown status";
+}
@@ -0,0 +1,201 @@
+/**
+    PalmsAPI.h
+    Purpose: Stable C interface of the standalone PALMS library (libpalms)
+             Images are passed as column-major m x n x nr_channels double arrays,
+             i.e., in the memory layout of MATLAB and of the solver
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#ifndef PALMSAPI_H
+#define PALMSAPI_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PALMS_API_VERSION 15
+
+typedef enum {
+    PALMS_OK = 0,
+    PALMS_ERROR_INVALID_ARGUMENT = 1,
+    PALMS_ERROR_OUT_OF_MEMORY = 2,
+    PALMS_ERROR_INTERNAL = 3,
+    PALMS_TRUNCATED = 4,        /* time budget exhausted or cancelled; outputs hold the current consensus */
+    PALMS_ERROR_CHECKPOINT = 5  /* checkpoint cannot be read or does not belong to the image and parameters */
+} palms_status;
+
+/* Setup of solves (Givens tables, stripe plans, state workspaces and scratch buffers) kept across solves,
+   see palms_cache_create */
+typedef struct palms_cache palms_cache;
+
+/* Parameters of affineLinearPartitioning; initialize with palms_default_parameters.
+   struct_size allows to extend the struct without breaking the ABI: new versions only append fields, and the
+   fields of each version increase sizeof(palms_parameters), so that struct_size identifies the version
+   (a field that would fit into the tail padding of the previous version is preceded by a reserved one). */
+typedef struct {
+    size_t struct_size;
+    double gamma;       /* boundary penalty (larger choice -> less segments), default 1.0 */
+    int max_iter;       /* max number of ADMM iterations, default 500 */
+    double mu_nu_step;  /* progression of the coupling penalties, default 1.3 */
+    int isotropic;      /* 1: near-isotropic, 0: anisotropic discretization, default 1 */
+    double split_tol;   /* relative difference stopping criterion, default 1e-2 */
+    int nr_threads;     /* number of OpenMP threads, default 32 */
+    int verbose;        /* print iterations, default 0 */
+    int packed_layout;  /* solve diagonal/horizontal stripes on a sheared/transposed copy, default 1 */
+    double time_budget; /* time budget of a solve in seconds, <= 0: unlimited (default) */
+    const volatile int *cancel; /* the solve is cut short as soon as *cancel != 0, may be NULL (default) */
+    int jacobi;         /* 1: solve all directions concurrently from the previous iterate (Jacobi variant),
+                           0: one direction after another (Gauss-Seidel, default) */
+    int reserved;       /* tail padding of version 6, unused (0) */
+    int long_stripe_length; /* min length of stripes solved with the parallel 1D solver (identical result),
+                               if they exceed an equal share of the pixels per thread; <= 0: never, default 8192 */
+    const char *tuning_profile; /* path of the tuning profile (see palms_autotune); the thread count, schedule
+                                   and layout of each direction are taken from it if it has an entry for the
+                                   image shape, NULL: nr_threads and packed_layout for all directions (default);
+                                   with jacobi = 1, only the layouts apply (the stripes of all directions are
+                                   solved by one pool of nr_threads threads) */
+    int adaptive_penalties; /* 1: choose the progression of the coupling penalties from the coupling residual and
+                               the change of the 1D partitions (mu_nu_step, but at most 1.5 while the partitions
+                               form; afterwards at least mu_nu_step), 0: fixed progression (default) */
+    const char *checkpoint_path; /* file of periodic checkpoints of the solver state (written in the background,
+                                    replaced atomically), NULL: none (default) */
+    int checkpoint_interval;    /* number of iterations between checkpoints, default 10 */
+    int checkpoint_float32;     /* 1: single precision checkpoints (half the size, the resumed solve is close to
+                                   but not bit-exact with the uninterrupted one), default 0 */
+    int compress_channels;      /* 1: if the channel vectors of f span a lower-dimensional space (e.g. hyperspectral
+                                   images), solve on the coordinates w.r.t. an orthonormal basis of the span and map
+                                   the result back (the model is invariant under orthogonal channel transforms;
+                                   only the stopping criterion is evaluated on the coordinates), default 0 */
+    palms_cache *cache;         /* Givens tables, stripe plans, state workspaces and scratch buffers are taken from
+                                   and added to the cache (identical result), NULL: set up per solve (default) */
+    double *deviation;          /* receives the splitting deviation of the last iteration of palms_partition or
+                                   palms_resume (the solve converged if it is <= split_tol, -1 before the first
+                                   iteration), may be NULL (default) */
+} palms_parameters;
+
+/* Returns PALMS_API_VERSION of the linked library */
+int palms_api_version(void);
+
+/* Fills the first size bytes of par with the defaults of affineLinearPartitioning and sets struct_size = size;
+   size is sizeof(palms_parameters) of the caller's header, the memory beyond it is not touched */
+void palms_default_parameters_sized(palms_parameters *par, size_t size);
+
+/* Entry point of binaries built against a header before API version 13: fills only the fields of version 1
+   (whose struct is the smallest), since the size of the caller's struct is unknown */
+void palms_default_parameters(palms_parameters *par);
+
+/* Fills par with the defaults of affineLinearPartitioning */
+#define palms_default_parameters(par) palms_default_parameters_sized((par),sizeof(palms_parameters))
+
+/* Computes the piecewise affine-linear partitioning of the image f.
+   Outputs u,a,b,c (m x n x nr_channels) and partition (m x n, 1-based labels) are written
+   to caller-provided memory; each output may be NULL if it is not needed.
+   nr_iterations (may be NULL) receives the number of performed ADMM iterations.
+   With a time budget, the progression of the coupling penalties is increased if the projected time
+   exceeds the budget; PALMS_TRUNCATED is returned if the solve was cut short by the budget or cancel. */
+palms_status palms_partition(const double *f, int m, int n, int nr_channels,
+                             const palms_parameters *par,
+                             double *u, double *a, double *b, double *c,
+                             int *partition, int *nr_iterations);
+
+/* Continues the solve of f (the same image as in the checkpointed solve) from a checkpoint written with
+   par->checkpoint_path; outputs as in palms_partition, nr_iterations counts all iterations. With a double
+   precision checkpoint and the same parameters (no time budget), the result is bit-exact with the
+   uninterrupted solve. Returns PALMS_ERROR_CHECKPOINT if the checkpoint does not belong to f, was
+   written with a different gamma, isotropic, mu_nu_step, adaptive_penalties or jacobi, or holds an
+   iteration beyond max_iter or invalid coupling penalties. */
+palms_status palms_resume(const char *checkpoint_path, const double *f, int m, int n, int nr_channels,
+                          const palms_parameters *par,
+                          double *u, double *a, double *b, double *c,
+                          int *partition, int *nr_iterations);
+
+/* Calibrates the thread count, OpenMP schedule and layout of each direction for m x n x nr_channels
+   images on a synthetic image and adds them to the profile par->tuning_profile (entries that are
+   already in the profile are kept; concurrent autotuners serialize their updates by the lock file
+   <profile>.lock). Takes a few direction solves per candidate configuration; a palms_cache picks up the
+   changed profile with the next solve. */
+palms_status palms_autotune(int m, int n, int nr_channels, const palms_parameters *par);
+
+/* Creates a cache for the setup of solves: Givens tables by stripe length and data weight, stripe plans
+   by image shape and configuration, state workspaces and scratch buffers (packed copies, next iterate of the
+   Jacobi variant) by image shape (the least recently used entries are dropped). Repeated solves of a shape,
+   e.g. by a long-running service, then skip their setup; the Givens tables are reused by solves with the
+   same gamma and the fixed progression of up to 256 iterations (one table per iteration).
+   The cache has to outlive the solves that use it and must not be used by concurrent solves.
+   Returns NULL if out of memory. */
+palms_cache *palms_cache_create(void);
+
+/* Releases the cache */
+void palms_cache_destroy(palms_cache *cache);
+
+/* Returns the number of lookups of tables, plans, workspaces and scratch buffers that were found in the cache (hits)
+   and that had to be set up (misses); both may be NULL */
+void palms_cache_stats(const palms_cache *cache, size_t *hits, size_t *misses);
+
+/* Solver that keeps the ADMM state of the last solve, so that local edits of the image can be
+   re-solved incrementally: the ADMM scheme is run on a window around the edited region, warm-started
+   from the kept state (with the coupling penalties of an earlier iteration), and the window is enlarged
+   until its result agrees with the kept one on the window border. The work of an update is at most
+   that of the full solve; if the windows do not settle, the full image is solved warm-started. */
+typedef struct palms_solver palms_solver;
+
+/* Creates a solver for m x n x nr_channels images; par may be NULL for the defaults */
+palms_status palms_solver_create(int m, int n, int nr_channels, const palms_parameters *par,
+                                 palms_solver **solver);
+
+/* Releases the solver and its cached state */
+void palms_solver_destroy(palms_solver *solver);
+
+/* Full solve of f (as palms_partition); the resulting state is cached in the solver
+   (a cut short solve is not cached, the next update is a full solve) */
+palms_status palms_solver_solve(palms_solver *solver, const double *f,
+                                double *u, double *a, double *b, double *c,
+                                int *partition, int *nr_iterations);
+
+/* Re-solves after f has been edited in the pixels with dirty[i + j*m] != 0 (m x n mask).
+   Falls back to a full solve if the solver has no cached state yet. */
+palms_status palms_solver_update(palms_solver *solver, const double *f, const unsigned char *dirty,
+                                 double *u, double *a, double *b, double *c,
+                                 int *partition, int *nr_iterations);
+
+/* As palms_solver_update for the rectangle of rows row,...,row+height-1 and columns col,...,col+width-1
+   (0-based, clipped to the image) */
+palms_status palms_solver_update_rect(palms_solver *solver, const double *f,
+                                      int row, int col, int height, int width,
+                                      double *u, double *a, double *b, double *c,
+                                      int *partition, int *nr_iterations);
+
+/* Sink for encoded segment streams; returns 0 on success */
+typedef int (*palms_write_fn)(const void *data, size_t size, void *user);
+
+/* Encodes a result as one record per segment (affine coefficients of all channels and
+   run-length encoded pixel set, see SegmentEncoding.h) and passes it to write as a stream.
+   partition must hold 1-based labels as produced by palms_partition, each of 1,...,max label
+   with at least one pixel. The encoding is lossy: the coefficients of a segment are the means of
+   a, b, c over the segment, whose pixels have jets that agree up to the 1% relative tolerance of
+   the partition (between neighbors); the rasterized u deviates from the solver's u accordingly
+   (on natural images by about 1e-5 of the intensity range, up to a few 1e-3 for many small segments). */
+palms_status palms_encode_segments(const int *partition, const double *a, const double *b, const double *c,
+                                   int m, int n, int nr_channels, palms_write_fn write, void *user);
+
+/* Reads the dimensions of an encoded segment stream */
+palms_status palms_segments_info(const void *data, size_t size,
+                                 int *m, int *n, int *nr_channels, int *nr_segments);
+
+/* Rebuilds the dense u (m x n x nr_channels) and partition (m x n) from an encoded segment stream
+   (u from the segment means, see palms_encode_segments); each output may be NULL.
+   Streams with a segment without pixels or a label out of range are rejected. */
+palms_status palms_rasterize_segments(const void *data, size_t size, double *u, int *partition);
+
+/* Human readable description of a status code */
+const char *palms_status_string(palms_status status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
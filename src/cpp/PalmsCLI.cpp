@@ -0,0 +1,509 @@
+/**
+    PalmsCLI.cpp
+    Purpose: Command-line tool for affine-linear image partitioning without MATLAB
+             Reads a PGM/PPM/PFM image and writes u,a,b,c and the label image
+             to memory-mapped raw files <prefix>_u.raw, ..., <prefix>_partition.raw
+             or the compact segment stream <prefix>.seg
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <getopt.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "ImageIO.h"
+#include "PalmsAPI.h"
+#include "linewiseAffineMS.h"
+
+enum OutputFormat { FORMAT_DENSE, FORMAT_SEGMENTS };
+
+static void PrintUsage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <input.pgm|ppm|pfm|raw> <output_prefix>\n"
+            "       %s --rasterize <input.seg> <output_prefix>\n"
+            "       %s --compareSchemes [options] <input.pgm|ppm|pfm|raw>\n"
+            "       %s --verify [options] <input.pgm|ppm|pfm|raw>\n"
+            "Options (cf. affineLinearPartitioning.m):\n"
+            "  --gamma=<value>       boundary penalty (default: 1.0)\n"
+            "  --maxIter=<value>     max number of ADMM iterations (default: 500)\n"
+            "  --muNuStep=<value>    progression of the coupling penalties (default: 1.3)\n"
+            "  --adaptivePenalties=<0|1>  adapt the progression to the coupling residual and the change of the\n"
+            "                        1D partitions: --muNuStep, at most 1.5, while they form, then at least\n"
+            "                        --muNuStep (default: 0)\n"
+            "  --isotropic=<0|1>     anisotropic (0) or near-isotropic (1) discretization (default: 1)\n"
+            "  --splitTol=<value>    relative difference stopping criterion (default: 0.01)\n"
+            "  --nr_threads=<value>  number of OpenMP threads (default: 32)\n"
+            "  --verbose             print iterations\n"
+            "  --packedLayout=<0|1>  solve diagonal/horizontal stripes on a sheared/transposed copy (default: 1)\n"
+            "  --timeBudget=<sec>    return the current result after the given time (default: unlimited);\n"
+            "                        SIGINT/SIGTERM also cut the solve short and the current result is written\n"
+            "  --scheme=<gaussSeidel|jacobi>  update the directions one after another (default) or\n"
+            "                        all at once from the previous iterate\n"
+            "  --compareSchemes      report iterations and time of both schemes (no output files)\n"
+            "  --verify              check that the variants with identical result (see README) reproduce the\n"
+            "                        reference solve of the image and of synthetic images, and the fused\n"
+            "                        subproblem assembly the reference assembly up to rounding (no output files)\n"
+            "  --longStripeLength=<value>  min length of stripes solved with the parallel 1D solver (default: 8192,\n"
+            "                        0: never); only stripes longer than the pixels per thread are affected\n"
+            "  --checkpoint=<path>   write a checkpoint of the solver state every --checkpointInterval iterations\n"
+            "  --checkpointInterval=<value>  iterations between checkpoints (default: 10)\n"
+            "  --checkpointFloat32   single precision checkpoints (resume is not bit-exact)\n"
+            "  --resume=<path>       continue the solve of the input image from a checkpoint\n"
+            "  --compressChannels    solve on an orthonormal basis of the channel span of the image (exact;\n"
+            "                        for images with many linearly dependent channels, e.g. hyperspectral)\n"
+            "  --profile=<path>      take thread count, schedule and layout per direction from the tuning profile\n"
+            "                        (only the layout with --scheme=jacobi)\n"
+            "  --autotune            calibrate the image shape (if not yet in the profile) before the solve;\n"
+            "                        the profile defaults to $HOME/.palms_profile\n"
+            "  --format=<dense|segments>  dense raw files (default) or one record per segment\n"
+            "  --rasterize           rebuild <prefix>_u.raw and <prefix>_partition.raw from a segment stream\n",
+            name,name,name,name);
+}
+
+// Set by SIGINT/SIGTERM, the solver returns its current result
+static volatile int cancel_requested = 0;
+
+static void RequestCancel(int)
+{
+    cancel_requested = 1;
+}
+
+static int WriteToFile(const void* data, size_t size, void* user)
+{
+    return (fwrite(data,1,size,(FILE*) user) == size) ? 0 : 1;
+}
+
+// Rebuilds the dense u and the partition from a segment stream
+static int Rasterize(const char* input_path, const std::string &prefix)
+{
+    MappedInput input;
+    int m, n, nr_channels, nr_segments;
+    if (!input.open(input_path) ||
+        palms_segments_info(input.getData(),input.getSize(),&m,&n,&nr_channels,&nr_segments) != PALMS_OK) {
+        fprintf(stderr,"Error: cannot read segment stream %s\n",input_path);
+        return 1;
+    }
+    MappedOutput u, partition;
+    if (!u.create((prefix+"_u.raw").c_str(),RAW_FLOAT64,m,n,nr_channels) ||
+        !partition.create((prefix+"_partition.raw").c_str(),RAW_INT32,m,n,1)) {
+        fprintf(stderr,"Error: cannot create output files %s_*.raw\n",prefix.c_str());
+        return 1;
+    }
+    palms_status status = palms_rasterize_segments(input.getData(),input.getSize(),
+                                                   (double*) u.getData(),(int*) partition.getData());
+    if (status != PALMS_OK) {
+        fprintf(stderr,"Error: %s\n",palms_status_string(status));
+        return 1;
+    }
+    return 0;
+}
+
+// Removes the output files of a failed run
+static void RemoveOutputs(const std::vector<std::string> &paths)
+{
+    for(size_t k = 0; k < paths.size(); k++)
+        remove(paths[k].c_str());
+}
+
+// Solves from scratch or, if resume_path is set, from a checkpoint
+static palms_status Partition(const cube &f, const palms_parameters &par, const char* resume_path,
+                              double* u, double* a, double* b, double* c, int* partition, int* nr_iterations)
+{
+    if (resume_path != NULL)
+        return palms_resume(resume_path,f.memptr(),f.n_rows,f.n_cols,f.n_slices,&par,u,a,b,c,
+                            partition,nr_iterations);
+    return palms_partition(f.memptr(),f.n_rows,f.n_cols,f.n_slices,&par,u,a,b,c,partition,nr_iterations);
+}
+
+// Solves with both update schemes and reports iterations, time and the deviation of the results
+static int CompareSchemes(const cube &f, palms_parameters par)
+{
+    const int m = f.n_rows;
+    const int n = f.n_cols;
+    const int nr_channels = f.n_slices;
+    const char* names[2] = {"Gauss-Seidel", "Jacobi"};
+    std::vector<double> u[2];
+    for(int k = 0; k < 2; k++) {
+        par.jacobi = k;
+        u[k].resize(f.n_elem);
+        std::vector<int> partition((size_t) m*n);
+        int nr_iterations = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        palms_status status = palms_partition(f.memptr(),m,n,nr_channels,&par,u[k].data(),NULL,NULL,NULL,
+                                              partition.data(),&nr_iterations);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        if (status != PALMS_OK && status != PALMS_TRUNCATED) {
+            fprintf(stderr,"Error: %s\n",palms_status_string(status));
+            return 1;
+        }
+        int nr_segments = 0;
+        for(size_t i = 0; i < partition.size(); i++)
+            nr_segments = std::max(nr_segments,partition[i]);
+        printf("%-12s %5d iterations %9.3f s %7d segments%s\n",names[k],nr_iterations,seconds,nr_segments,
+               (status == PALMS_TRUNCATED) ? " (cut short)" : "");
+    }
+    double max_dev = 0;
+    for(size_t i = 0; i < u[0].size(); i++)
+        max_dev = std::max(max_dev,std::fabs(u[0][i]-u[1][i]));
+    printf("Max deviation of u: %g\n",max_dev);
+    return 0;
+}
+
+// Result of a solve for the comparisons of --verify
+struct Solution
+{
+    std::vector<double> u, a, b, c;
+    std::vector<int> partition;
+    int nr_iterations;
+};
+
+static bool Solve(const cube &f, const palms_parameters &par, Solution &solution, const char* resume_path = NULL)
+{
+    const size_t nr_pixels = (size_t) f.n_rows*f.n_cols;
+    solution.u.resize(f.n_elem);
+    solution.a.resize(f.n_elem);
+    solution.b.resize(f.n_elem);
+    solution.c.resize(f.n_elem);
+    solution.partition.resize(nr_pixels);
+    solution.nr_iterations = 0;
+    palms_status status = Partition(f,par,resume_path,solution.u.data(),solution.a.data(),solution.b.data(),
+                                    solution.c.data(),solution.partition.data(),&solution.nr_iterations);
+    if (status != PALMS_OK) {
+        fprintf(stderr,"Error: %s\n",palms_status_string(status));
+        return false;
+    }
+    return true;
+}
+
+// Bitwise comparison of two results
+static bool Identical(const Solution &x, const Solution &y)
+{
+    const size_t size = x.u.size()*sizeof(double);
+    return x.nr_iterations == y.nr_iterations && y.u.size() == x.u.size() &&
+           memcmp(x.u.data(),y.u.data(),size) == 0 && memcmp(x.a.data(),y.a.data(),size) == 0 &&
+           memcmp(x.b.data(),y.b.data(),size) == 0 && memcmp(x.c.data(),y.c.data(),size) == 0 &&
+           x.partition == y.partition;
+}
+
+// Solves f with the reference and the variant parameters and reports whether the results are identical
+static bool CompareSolves(const char* name, const cube &f, const palms_parameters &reference,
+                          const palms_parameters &variant)
+{
+    Solution x, y;
+    const bool passed = Solve(f,reference,x) && Solve(f,variant,y) && Identical(x,y);
+    printf("%-56s %s\n",name,passed ? "PASS" : "FAIL");
+    return passed;
+}
+
+// Synthetic 1 x n image: piecewise affine segments of random length with random slopes and uniform noise
+static cube RandomStripe(const int n, const int nr_channels, const unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0,1.0);
+    cube f(1,n,nr_channels);
+    int segment_end = 0;
+    std::vector<double> offsets(nr_channels), slopes(nr_channels);
+    for(int j = 0; j < n; j++) {
+        if (j == segment_end) {
+            segment_end = j + 1 + (int) (uniform(generator)*n/20);
+            for(int ch = 0; ch < nr_channels; ch++) {
+                offsets[ch] = uniform(generator);
+                slopes[ch] = (uniform(generator)-0.5)*2.0/n;
+            }
+        }
+        for(int ch = 0; ch < nr_channels; ch++)
+            f(0,j,ch) = offsets[ch] + slopes[ch]*j + 0.05*(uniform(generator)-0.5);
+    }
+    return f;
+}
+
+// Checks the claims of identical results of solver variants on f and on synthetic images
+static int Verify(const cube &f, palms_parameters par)
+{
+    bool passed = true;
+    // Packed (sheared/transposed) layout vs stripes gathered in place, with both schemes
+    for(int jacobi = 0; jacobi <= 1; jacobi++) {
+        palms_parameters in_place = par;
+        in_place.packed_layout = 0;
+        in_place.jacobi = jacobi;
+        palms_parameters packed = par;
+        packed.packed_layout = 1;
+        packed.jacobi = jacobi;
+        passed &= CompareSolves(jacobi ? "packed layout (Jacobi scheme)" : "packed layout",f,in_place,packed);
+    }
+    // Parallel 1D solver (long_stripe_length) vs the sequential DP, on f and on long random stripes
+    // (at least two threads, otherwise the sequential DP is used)
+    par.nr_threads = std::max(par.nr_threads,2);
+    palms_parameters sequential_dp = par;
+    sequential_dp.long_stripe_length = 0;
+    palms_parameters parallel_dp = par;
+    parallel_dp.long_stripe_length = 1;
+    passed &= CompareSolves("parallel 1D solver (image)",f,sequential_dp,parallel_dp);
+    const int stripe_lengths[2] = {10000, 30000};
+    const double gammas[2] = {par.gamma, 0.01*par.gamma};
+    for(int k = 0; k < 2; k++) {
+        const cube stripe = RandomStripe(stripe_lengths[k],3,k+1);
+        for(int g = 0; g < 2; g++) {
+            char name[64];
+            snprintf(name,sizeof(name),"parallel 1D solver (random stripe %d, gamma %g)",stripe_lengths[k],gammas[g]);
+            sequential_dp.gamma = parallel_dp.gamma = gammas[g];
+            passed &= CompareSolves(name,stripe,sequential_dp,parallel_dp);
+        }
+    }
+    // Resume from a double precision checkpoint of the middle iteration vs the uninterrupted solve
+    Solution reference;
+    if (!Solve(f,par,reference))
+        return 1;
+    const int checkpoint_iteration = reference.nr_iterations/2;
+    if (checkpoint_iteration >= 2) {
+        char checkpoint_path[] = "/tmp/palms_verify_XXXXXX";
+        const int fd = mkstemp(checkpoint_path);
+        if (fd < 0) {
+            fprintf(stderr,"Error: cannot create a temporary checkpoint\n");
+            return 1;
+        }
+        close(fd);
+        palms_parameters interrupted = par;
+        interrupted.max_iter = checkpoint_iteration;
+        interrupted.checkpoint_path = checkpoint_path;
+        interrupted.checkpoint_interval = checkpoint_iteration;
+        Solution first_part, resumed;
+        const bool resumed_ok = Solve(f,interrupted,first_part) && Solve(f,par,resumed,checkpoint_path) &&
+                                Identical(reference,resumed);
+        printf("%-56s %s\n","resume from checkpoint",resumed_ok ? "PASS" : "FAIL");
+        passed &= resumed_ok;
+        remove(checkpoint_path);
+    }
+    // Fused subproblem assembly vs the subproblem data assembled as full cubes, for each direction from the state
+    // of the middle iteration of the reference solve
+    if (checkpoint_iteration >= 2) {
+        ADMMParameters admm;
+        admm.gamma = par.gamma;
+        admm.nr_dirs = (par.isotropic == 0) ? 2 : 4;
+        admm.max_iter = checkpoint_iteration;
+        admm.mu_nu_step = par.mu_nu_step;
+        admm.split_tol = par.split_tol;
+        admm.nr_threads = par.nr_threads;
+        ADMMState state;
+        InitADMMState(state,f,admm.nr_dirs);
+        cube u, a, b, c;
+        AffineLinearADMM(f,admm,state,u,a,b,c);
+        const double deviation = FusedSolverDeviation(f,state,par.gamma);
+        // Rounding differences only (the solutions are not fed back, so they cannot grow here)
+        double f_max = 1;
+        for(uword i = 0; i < f.n_elem; i++)
+            f_max = std::max(f_max,std::fabs(f(i)));
+        const bool fused_ok = (deviation <= 1e-12*f_max);
+        printf("%-56s %s (max deviation %g)\n","fused subproblem assembly",fused_ok ? "PASS" : "FAIL",deviation);
+        passed &= fused_ok;
+    }
+    // Solves with a cache (cold and warm, both schemes) vs solves that set up everything themselves
+    palms_cache* cache = palms_cache_create();
+    if (cache == NULL) {
+        fprintf(stderr,"Error: cannot create the cache\n");
+        return 1;
+    }
+    palms_parameters cached = par;
+    cached.cache = cache;
+    passed &= CompareSolves("cache (cold)",f,par,cached);
+    passed &= CompareSolves("cache (warm)",f,par,cached);
+    par.jacobi = cached.jacobi = 1;
+    passed &= CompareSolves("cache (warm, Jacobi scheme)",f,par,cached);
+    palms_cache_destroy(cache);
+    printf("%s\n",passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    palms_parameters par;
+    palms_default_parameters(&par);
+
+    static const struct option long_options[] = {
+        {"gamma",      required_argument, NULL, 'g'},
+        {"maxIter",    required_argument, NULL, 'i'},
+        {"muNuStep",   required_argument, NULL, 's'},
+        {"adaptivePenalties", required_argument, NULL, 'a'},
+        {"isotropic",  required_argument, NULL, 'o'},
+        {"splitTol",   required_argument, NULL, 't'},
+        {"nr_threads", required_argument, NULL, 'p'},
+        {"verbose",    no_argument,       NULL, 'v'},
+        {"packedLayout", required_argument, NULL, 'l'},
+        {"timeBudget", required_argument, NULL, 'b'},
+        {"scheme",     required_argument, NULL, 'e'},
+        {"compareSchemes", no_argument,   NULL, 'c'},
+        {"verify",     no_argument,       NULL, 'V'},
+        {"longStripeLength", required_argument, NULL, 'L'},
+        {"checkpoint", required_argument, NULL, 'k'},
+        {"checkpointInterval", required_argument, NULL, 'K'},
+        {"checkpointFloat32", no_argument, NULL, 'F'},
+        {"resume",     required_argument, NULL, 'R'},
+        {"compressChannels", no_argument, NULL, 'C'},
+        {"profile",    required_argument, NULL, 'P'},
+        {"autotune",   no_argument,       NULL, 'A'},
+        {"format",     required_argument, NULL, 'f'},
+        {"rasterize",  no_argument,       NULL, 'r'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    OutputFormat format = FORMAT_DENSE;
+    bool rasterize = false;
+    bool compare_schemes = false;
+    bool verify = false;
+    bool autotune = false;
+    std::string profile_path;
+    const char* resume_path = NULL;
+    int opt;
+    while ((opt = getopt_long(argc,argv,"vh",long_options,NULL)) != -1) {
+        switch (opt) {
+            case 'g': par.gamma = atof(optarg); break;
+            case 'i': par.max_iter = atoi(optarg); break;
+            case 's': par.mu_nu_step = atof(optarg); break;
+            case 'a': par.adaptive_penalties = atoi(optarg); break;
+            case 'o': par.isotropic = atoi(optarg); break;
+            case 't': par.split_tol = atof(optarg); break;
+            case 'p': par.nr_threads = atoi(optarg); break;
+            case 'v': par.verbose = 1; break;
+            case 'l': par.packed_layout = atoi(optarg); break;
+            case 'b': par.time_budget = atof(optarg); break;
+            case 'f':
+                if (std::string(optarg) == "segments") {
+                    format = FORMAT_SEGMENTS;
+                } else if (std::string(optarg) != "dense") {
+                    PrintUsage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'e':
+                if (std::string(optarg) == "jacobi") {
+                    par.jacobi = 1;
+                } else if (std::string(optarg) != "gaussSeidel") {
+                    PrintUsage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'c': compare_schemes = true; break;
+            case 'V': verify = true; break;
+            case 'L': par.long_stripe_length = atoi(optarg); break;
+            case 'k': par.checkpoint_path = optarg; break;
+            case 'K': par.checkpoint_interval = atoi(optarg); break;
+            case 'F': par.checkpoint_float32 = 1; break;
+            case 'R': resume_path = optarg; break;
+            case 'C': par.compress_channels = 1; break;
+            case 'P': profile_path = optarg; break;
+            case 'A': autotune = true; break;
+            case 'r': rasterize = true; break;
+            case 'h': PrintUsage(argv[0]); return 0;
+            default: PrintUsage(argv[0]); return 2;
+        }
+    }
+    if (autotune && profile_path.empty() && getenv("HOME") != NULL)
+        profile_path = std::string(getenv("HOME")) + "/.palms_profile";
+    if (!profile_path.empty())
+        par.tuning_profile = profile_path.c_str();
+    if (argc-optind != ((compare_schemes || verify) ? 1 : 2)) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    const char* input_path = argv[optind];
+    if (compare_schemes || verify) {
+        cube f;
+        if (!ReadImage(input_path,f)) {
+            fprintf(stderr,"Error: cannot read image %s\n",input_path);
+            return 1;
+        }
+        return compare_schemes ? CompareSchemes(f,par) : Verify(f,par);
+    }
+    const std::string prefix = argv[optind+1];
+    if (rasterize)
+        return Rasterize(input_path,prefix);
+
+    cube f;
+    if (!ReadImage(input_path,f)) {
+        fprintf(stderr,"Error: cannot read image %s\n",input_path);
+        return 1;
+    }
+    const uint32_t m = f.n_rows;
+    const uint32_t n = f.n_cols;
+    const uint32_t nr_channels = f.n_slices;
+    if (autotune) {
+        const palms_status tune_status = palms_autotune(m,n,nr_channels,&par);
+        if (tune_status != PALMS_OK)
+            fprintf(stderr,"Warning: autotuning failed (%s), using the default configuration\n",
+                    palms_status_string(tune_status));
+    }
+    par.cancel = &cancel_requested;
+    signal(SIGINT,RequestCancel);
+    signal(SIGTERM,RequestCancel);
+
+    int nr_iterations = 0;
+    double deviation = -1;
+    par.deviation = &deviation;
+    palms_status status;
+    // Output files, removed again if the run fails
+    std::vector<std::string> outputs;
+    if (format == FORMAT_DENSE) {
+        outputs.push_back(prefix+"_u.raw");
+        outputs.push_back(prefix+"_a.raw");
+        outputs.push_back(prefix+"_b.raw");
+        outputs.push_back(prefix+"_c.raw");
+        outputs.push_back(prefix+"_partition.raw");
+        // The solver writes its results directly into the mapped output files
+        MappedOutput u, a, b, c, partition;
+        if (!u.create(outputs[0].c_str(),RAW_FLOAT64,m,n,nr_channels) ||
+            !a.create(outputs[1].c_str(),RAW_FLOAT64,m,n,nr_channels) ||
+            !b.create(outputs[2].c_str(),RAW_FLOAT64,m,n,nr_channels) ||
+            !c.create(outputs[3].c_str(),RAW_FLOAT64,m,n,nr_channels) ||
+            !partition.create(outputs[4].c_str(),RAW_INT32,m,n,1)) {
+            fprintf(stderr,"Error: cannot create output files %s_*.raw\n",prefix.c_str());
+            RemoveOutputs(outputs);
+            return 1;
+        }
+        status = Partition(f,par,resume_path,(double*) u.getData(),(double*) a.getData(),
+                           (double*) b.getData(),(double*) c.getData(),
+                           (int*) partition.getData(),&nr_iterations);
+    } else {
+        // Only the segment records are stored, u can be rebuilt with --rasterize
+        std::vector<double> a(f.n_elem), b(f.n_elem), c(f.n_elem);
+        std::vector<int> partition((size_t) m*n);
+        status = Partition(f,par,resume_path,NULL,a.data(),b.data(),c.data(),partition.data(),&nr_iterations);
+        if (status == PALMS_OK || status == PALMS_TRUNCATED) {
+            const palms_status solve_status = status;
+            outputs.push_back(prefix+".seg");
+            FILE* out = fopen(outputs[0].c_str(),"wb");
+            if (out == NULL) {
+                fprintf(stderr,"Error: cannot create output file %s\n",outputs[0].c_str());
+                return 1;
+            }
+            status = palms_encode_segments(partition.data(),a.data(),b.data(),c.data(),m,n,nr_channels,
+                                           WriteToFile,out);
+            if (fclose(out) != 0 && status == PALMS_OK)
+                status = PALMS_ERROR_INTERNAL;
+            if (status == PALMS_OK)
+                status = solve_status;
+        }
+    }
+    if (status == PALMS_TRUNCATED) {
+        fprintf(stderr,"Warning: solve cut short after %d iterations, the current result was written\n",
+                nr_iterations);
+    } else if (status != PALMS_OK) {
+        fprintf(stderr,"Error: %s\n",palms_status_string(status));
+        RemoveOutputs(outputs);
+        return 1;
+    } else if (!(deviation >= 0 && deviation <= par.split_tol) && !par.verbose) {
+        // The library only reports this (and the number of iterations) in verbose mode
+        fprintf(stderr,"Warning: not converged after %d iterations (deviation %g > splitTol %g)\n",
+                nr_iterations,deviation,par.split_tol);
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+/**
+    PalmsClient.cpp
+    Purpose: Stand-in client of the solver daemon palmsd for testing
+             Places an image in a shared memory file (memfd), sends solve requests for it to the daemon and
+             reports the round-trip latencies; the result of the last solve can be written as raw files
+             as by the command-line tool
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "DaemonProtocol.h"
+#include "ImageIO.h"
+#include "LatencyHistogram.h"
+#include "PalmsAPI.h"
+
+static void PrintUsage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <input.pgm|ppm|pfm|raw> [<output_prefix>]\n"
+            "       %s [--stats] [--shutdown]\n"
+            "Sends solve requests for the image to palmsd and writes the result of the last one to\n"
+            "<output_prefix>_u.raw, ..., <output_prefix>_partition.raw\n"
+            "Options (cf. palms):\n"
+            "  --socket=<path>       path of the daemon's socket (default: " DAEMON_DEFAULT_SOCKET ")\n"
+            "  --gamma=<value>       boundary penalty (default: 1.0)\n"
+            "  --maxIter=<value>     max number of ADMM iterations (default: 500)\n"
+            "  --muNuStep=<value>    progression of the coupling penalties (default: 1.3)\n"
+            "  --adaptivePenalties=<0|1>  adaptive progression of the coupling penalties (default: 0)\n"
+            "  --isotropic=<0|1>     anisotropic (0) or near-isotropic (1) discretization (default: 1)\n"
+            "  --splitTol=<value>    relative difference stopping criterion (default: 0.01)\n"
+            "  --timeBudget=<sec>    time budget of a solve (default: unlimited)\n"
+            "  --scheme=<gaussSeidel|jacobi>  update scheme of the directions (default: gaussSeidel)\n"
+            "  --compressChannels    solve on an orthonormal basis of the channel span of the image\n"
+            "  --repeat=<value>      number of solve requests (default: 1)\n"
+            "  --stats               print the daemon's latency histograms and cache statistics\n"
+            "  --shutdown            shut the daemon down\n",
+            name,name);
+}
+
+static double Seconds(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+static int Connect(const char* path)
+{
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path,path);
+    const int fd = socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd,(struct sockaddr*) &addr,sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends the request (with the descriptor of the shared memory file if fd >= 0) and receives the reply;
+// returns false on a communication failure
+static bool Request(const int socket_fd, const DaemonRequest &request, const int fd, DaemonReply &reply)
+{
+    struct iovec iov;
+    iov.iov_base = (void*) &request;
+    iov.iov_len = sizeof(request);
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control,0,sizeof(control));
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg),&fd,sizeof(int));
+    }
+    if (sendmsg(socket_fd,&msg,MSG_NOSIGNAL) != (ssize_t) sizeof(request))
+        return false;
+    return recv(socket_fd,&reply,sizeof(reply),0) == (ssize_t) sizeof(reply) && memcmp(reply.magic,"PLMD",4) == 0;
+}
+
+// Copies the array at offset of the shared memory file to a raw output file
+static bool WriteOutput(const unsigned char* shared, const size_t offset, const uint32_t dtype,
+                        const uint32_t m, const uint32_t n, const uint32_t nr_channels, const std::string &path)
+{
+    MappedOutput output;
+    if (!output.create(path.c_str(),dtype,m,n,nr_channels))
+        return false;
+    const size_t size = (size_t) m*n*nr_channels*((dtype == RAW_FLOAT64) ? sizeof(double) : sizeof(int32_t));
+    memcpy(output.getData(),shared + offset,size);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    palms_parameters par;
+    palms_default_parameters(&par);
+    std::string socket_path = DAEMON_DEFAULT_SOCKET;
+    int repeat = 1;
+    bool stats = false;
+    bool shutdown = false;
+    static struct option long_options[] = {
+        {"socket",     required_argument, NULL, 'S'},
+        {"gamma",      required_argument, NULL, 'g'},
+        {"maxIter",    required_argument, NULL, 'i'},
+        {"muNuStep",   required_argument, NULL, 's'},
+        {"adaptivePenalties", required_argument, NULL, 'a'},
+        {"isotropic",  required_argument, NULL, 'o'},
+        {"splitTol",   required_argument, NULL, 't'},
+        {"timeBudget", required_argument, NULL, 'b'},
+        {"scheme",     required_argument, NULL, 'e'},
+        {"compressChannels", no_argument, NULL, 'C'},
+        {"repeat",     required_argument, NULL, 'r'},
+        {"stats",      no_argument,       NULL, 'T'},
+        {"shutdown",   no_argument,       NULL, 'D'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc,argv,"h",long_options,NULL)) != -1) {
+        switch (opt) {
+            case 'S': socket_path = optarg; break;
+            case 'g': par.gamma = atof(optarg); break;
+            case 'i': par.max_iter = atoi(optarg); break;
+            case 's': par.mu_nu_step = atof(optarg); break;
+            case 'a': par.adaptive_penalties = atoi(optarg); break;
+            case 'o': par.isotropic = atoi(optarg); break;
+            case 't': par.split_tol = atof(optarg); break;
+            case 'b': par.time_budget = atof(optarg); break;
+            case 'e':
+                if (std::string(optarg) == "jacobi") {
+                    par.jacobi = 1;
+                } else if (std::string(optarg) != "gaussSeidel") {
+                    PrintUsage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'C': par.compress_channels = 1; break;
+            case 'r': repeat = atoi(optarg); break;
+            case 'T': stats = true; break;
+            case 'D': shutdown = true; break;
+            case 'h': PrintUsage(argv[0]); return 0;
+            default: PrintUsage(argv[0]); return 2;
+        }
+    }
+    const int nr_args = argc-optind;
+    if (nr_args > 2 || (nr_args == 0 && !stats && !shutdown) || repeat < 1) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    const int socket_fd = Connect(socket_path.c_str());
+    if (socket_fd < 0) {
+        fprintf(stderr,"Error: cannot connect to the daemon on %s\n",socket_path.c_str());
+        return 1;
+    }
+    DaemonRequest request;
+    memset(&request,0,sizeof(request));
+    memcpy(request.magic,"PLMD",4);
+    DaemonReply reply;
+    int result = 0;
+
+    if (nr_args > 0) {
+        const char* input_path = argv[optind];
+        cube f;
+        if (!ReadImage(input_path,f)) {
+            fprintf(stderr,"Error: cannot read image %s\n",input_path);
+            return 1;
+        }
+        const uint32_t m = f.n_rows;
+        const uint32_t n = f.n_cols;
+        const uint32_t nr_channels = f.n_slices;
+        // The daemon solves on the shared memory file in place; it only accepts files sealed against shrinking
+        const size_t size = SharedImageOffset(m,n,nr_channels,6);
+        const int fd = memfd_create("palms_image",MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        void* shared = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd,size) == 0 && fcntl(fd,F_ADD_SEALS,F_SEAL_SHRINK) == 0)
+            shared = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        if (shared == MAP_FAILED) {
+            fprintf(stderr,"Error: cannot create the shared memory file\n");
+            return 1;
+        }
+        memcpy(shared,f.memptr(),f.n_elem*sizeof(double));
+
+        request.type = DAEMON_SOLVE;
+        request.m = m;
+        request.n = n;
+        request.nr_channels = nr_channels;
+        request.max_iter = par.max_iter;
+        request.isotropic = par.isotropic;
+        request.adaptive_penalties = par.adaptive_penalties;
+        request.jacobi = par.jacobi;
+        request.compress_channels = par.compress_channels;
+        request.gamma = par.gamma;
+        request.mu_nu_step = par.mu_nu_step;
+        request.split_tol = par.split_tol;
+        request.time_budget = par.time_budget;
+        LatencyHistogram round_trip("round trip");
+        LatencyHistogram service("service");
+        for(int k = 0; k < repeat; k++) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (!Request(socket_fd,request,fd,reply)) {
+                fprintf(stderr,"Error: no reply from the daemon\n");
+                return 1;
+            }
+            round_trip.record(Seconds(start));
+            service.record(reply.service_seconds);
+            if (reply.status != PALMS_OK && reply.status != PALMS_TRUNCATED) {
+                fprintf(stderr,"Error: %s\n",palms_status_string((palms_status) reply.status));
+                return 1;
+            }
+        }
+        if (reply.status == PALMS_TRUNCATED)
+            fprintf(stderr,"Warning: solve cut short after %d iterations\n",reply.nr_iterations);
+        std::string report;
+        round_trip.report(report);
+        service.report(report);
+        printf("Iterations: %d, last solve %.3f ms\n%s",reply.nr_iterations,1e3*reply.solve_seconds,report.c_str());
+
+        if (nr_args == 2) {
+            const std::string prefix = argv[optind+1];
+            const unsigned char* data = (const unsigned char*) shared;
+            const char* names[5] = {"_u.raw", "_a.raw", "_b.raw", "_c.raw", "_partition.raw"};
+            bool written = true;
+            for(int k = 1; k <= 5 && written; k++) {
+                const size_t offset = SharedImageOffset(m,n,nr_channels,k);
+                written = (k < 5) ? WriteOutput(data,offset,RAW_FLOAT64,m,n,nr_channels,prefix+names[k-1])
+                                  : WriteOutput(data,offset,RAW_INT32,m,n,1,prefix+names[k-1]);
+            }
+            if (!written) {
+                fprintf(stderr,"Error: cannot create output files %s_*.raw\n",prefix.c_str());
+                result = 1;
+            }
+        }
+        munmap(shared,size);
+        close(fd);
+    }
+    if (stats) {
+        request.type = DAEMON_STATS;
+        char report[DAEMON_MAX_REPORT+1];
+        ssize_t length = -1;
+        if (Request(socket_fd,request,-1,reply))
+            length = recv(socket_fd,report,DAEMON_MAX_REPORT,0);
+        if (length < 0) {
+            fprintf(stderr,"Error: no reply from the daemon\n");
+            return 1;
+        }
+        report[length] = '\0';
+        printf("Daemon:\n%s",report);
+    }
+    if (shutdown) {
+        request.type = DAEMON_SHUTDOWN;
+        if (!Request(socket_fd,request,-1,reply)) {
+            fprintf(stderr,"Error: no reply from the daemon\n");
+            return 1;
+        }
+    }
+    close(socket_fd);
+    return result;
+}
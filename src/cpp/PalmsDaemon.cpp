@@ -0,0 +1,400 @@
+/**
+    PalmsDaemon.cpp
+    Purpose: Long-running solver service palmsd for request-serving workloads of many medium-sized images
+             Listens on a Unix domain socket; input and outputs of a request are exchanged in place through a
+             shared memory file whose descriptor is passed with the request (see DaemonProtocol.h). The OpenMP
+             threads are pinned to the available cores once and stay alive between requests, the mappings of
+             the shared memory files of recent clients are kept, and Givens tables, stripe plans and workspaces
+             are kept in a palms_cache. Latency histograms are reported on request and at shutdown.
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <omp.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <string>
+#include <vector>
+#include "DaemonProtocol.h"
+#include "LatencyHistogram.h"
+#include "PalmsAPI.h"
+
+// Max number of shared memory files that stay mapped (one per recent client image)
+static const size_t MAX_MAPPINGS = 8;
+// Max number of pixels of a request (guards the size computation of the shared memory layout)
+static const double MAX_REQUEST_ELEMENTS = 1e11;
+
+// Mapping of a shared memory file, identified by its inode and size
+struct SharedMapping {
+    dev_t device;
+    ino_t inode;
+    size_t size;
+    void* data;
+};
+
+// Set by SIGINT/SIGTERM, the current solve is cut short (its reply reports PALMS_TRUNCATED) and the daemon
+// shuts down
+static volatile int shutdown_requested = 0;
+
+static void RequestShutdown(int)
+{
+    shutdown_requested = 1;
+}
+
+static void PrintUsage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Serves solve requests on a Unix domain socket (see DaemonProtocol.h, palms_client)\n"
+            "Options:\n"
+            "  --socket=<path>       path of the socket (default: " DAEMON_DEFAULT_SOCKET ")\n"
+            "  --nr_threads=<value>  number of OpenMP threads of all solves (default: number of available cores)\n"
+            "  --pin=<0|1>           pin the threads to the available cores (default: 1)\n"
+            "  --profile=<path>      take thread count, schedule and layout per direction from the tuning profile\n",
+            name);
+}
+
+static double Seconds(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+// Starts the OpenMP threads and pins thread k to the k-th available core (modulo their number); the
+// threads stay alive between the parallel regions of later solves
+static void StartThreads(const int nr_threads, const bool pin)
+{
+    omp_set_dynamic(0);
+    omp_set_num_threads(nr_threads);
+    std::vector<int> cores;
+    cpu_set_t available;
+    if (pin && sched_getaffinity(0,sizeof(available),&available) == 0) {
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu,&available))
+                cores.push_back(cpu);
+        }
+    }
+    #pragma omp parallel
+    {
+        if (!cores.empty()) {
+            cpu_set_t core;
+            CPU_ZERO(&core);
+            CPU_SET(cores[omp_get_thread_num() % cores.size()],&core);
+            pthread_setaffinity_np(pthread_self(),sizeof(core),&core);
+        }
+    }
+}
+
+// Returns the mapping of the shared memory file fd (mapped on first use, the least recently used
+// mapping is dropped); NULL on failure or if the file is not sealed against shrinking (a client could
+// otherwise truncate it during the solve, and the access of the mapping would raise SIGBUS)
+static void* MapSharedFile(const int fd, const size_t size, std::list<SharedMapping> &mappings)
+{
+    const int seals = fcntl(fd,F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK))
+        return NULL;
+    struct stat st;
+    if (fstat(fd,&st) != 0 || (size_t) st.st_size < size)
+        return NULL;
+    for(std::list<SharedMapping>::iterator it = mappings.begin(); it != mappings.end(); ++it) {
+        if (it->device == st.st_dev && it->inode == st.st_ino && it->size == (size_t) st.st_size) {
+            mappings.splice(mappings.begin(),mappings,it);
+            return it->data;
+        }
+    }
+    // A mapping keeps the file alive, hence its inode is not reused while it is in the list
+    void* data = mmap(NULL,st.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    if (data == MAP_FAILED)
+        return NULL;
+    if (mappings.size() >= MAX_MAPPINGS) {
+        munmap(mappings.back().data,mappings.back().size);
+        mappings.pop_back();
+    }
+    SharedMapping mapping;
+    mapping.device = st.st_dev;
+    mapping.inode = st.st_ino;
+    mapping.size = st.st_size;
+    mapping.data = data;
+    mappings.push_front(mapping);
+    return data;
+}
+
+// Receives a request and the passed file descriptor (-1 if none); returns the number of received bytes
+static ssize_t ReceiveRequest(const int socket_fd, DaemonRequest &request, int &fd)
+{
+    struct iovec iov;
+    iov.iov_base = &request;
+    iov.iov_len = sizeof(request);
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    fd = -1;
+    const ssize_t size = recvmsg(socket_fd,&msg,MSG_CMSG_CLOEXEC);
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg,cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&fd,CMSG_DATA(cmsg),sizeof(int));
+    }
+    return size;
+}
+
+class Daemon
+{
+private:
+    int nr_threads;
+    const char* tuning_profile;
+    palms_cache* cache;
+    std::list<SharedMapping> mappings;
+    LatencyHistogram service_latency;
+    LatencyHistogram solve_latency;
+    size_t nr_failed;
+public:
+    // Constructor
+    Daemon(const int nr_threads, const char* tuning_profile);
+    // Destructor (unmaps the shared memory files and releases the cache)
+    ~Daemon();
+    // Solves the request on the shared memory file fd
+    DaemonReply solve(const DaemonRequest &request, const int fd);
+    // Latency histograms and cache statistics as text
+    std::string report() const;
+};
+
+// Constructor
+Daemon::Daemon(const int nr_threads, const char* tuning_profile) :
+    service_latency("service"), solve_latency("solve")
+{
+    this->nr_threads = nr_threads;
+    this->tuning_profile = tuning_profile;
+    cache = palms_cache_create();
+    nr_failed = 0;
+}
+
+// Destructor
+Daemon::~Daemon()
+{
+    for(std::list<SharedMapping>::iterator it = mappings.begin(); it != mappings.end(); ++it)
+        munmap(it->data,it->size);
+    palms_cache_destroy(cache);
+}
+
+DaemonReply Daemon::solve(const DaemonRequest &request, const int fd)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    DaemonReply reply;
+    memset(&reply,0,sizeof(reply));
+    memcpy(reply.magic,"PLMD",4);
+    reply.status = PALMS_ERROR_INVALID_ARGUMENT;
+    const int m = request.m;
+    const int n = request.n;
+    const int nr_channels = request.nr_channels;
+    void* data = NULL;
+    if (fd >= 0 && m > 0 && n > 0 && nr_channels > 0 && (double) m*n*nr_channels <= MAX_REQUEST_ELEMENTS)
+        data = MapSharedFile(fd,SharedImageOffset(m,n,nr_channels,6),mappings);
+    if (data != NULL) {
+        palms_parameters par;
+        palms_default_parameters(&par);
+        par.gamma = request.gamma;
+        par.max_iter = request.max_iter;
+        par.mu_nu_step = request.mu_nu_step;
+        par.isotropic = request.isotropic;
+        par.split_tol = request.split_tol;
+        par.adaptive_penalties = request.adaptive_penalties;
+        par.jacobi = request.jacobi;
+        par.compress_channels = request.compress_channels;
+        par.time_budget = request.time_budget;
+        par.nr_threads = nr_threads;
+        par.tuning_profile = tuning_profile;
+        par.cancel = &shutdown_requested;
+        par.cache = cache;
+        // Input and outputs are used in place
+        unsigned char* base = (unsigned char*) data;
+        double* output[4];
+        for(int k = 0; k < 4; k++)
+            output[k] = (double*) (base + SharedImageOffset(m,n,nr_channels,k+1));
+        int nr_iterations = 0;
+        const std::chrono::steady_clock::time_point solve_start = std::chrono::steady_clock::now();
+        reply.status = palms_partition((const double*) base,m,n,nr_channels,&par,
+                                       output[0],output[1],output[2],output[3],
+                                       (int*) (base + SharedImageOffset(m,n,nr_channels,5)),&nr_iterations);
+        reply.solve_seconds = Seconds(solve_start);
+        reply.nr_iterations = nr_iterations;
+        solve_latency.record(reply.solve_seconds);
+    }
+    if (reply.status != PALMS_OK && reply.status != PALMS_TRUNCATED)
+        nr_failed++;
+    reply.service_seconds = Seconds(start);
+    service_latency.record(reply.service_seconds);
+    return reply;
+}
+
+std::string Daemon::report() const
+{
+    std::string out;
+    service_latency.report(out);
+    solve_latency.report(out);
+    size_t hits, misses;
+    palms_cache_stats(cache,&hits,&misses);
+    char line[160];
+    snprintf(line,sizeof(line),"failed requests: %zu, cache: %zu hits, %zu misses, threads: %d\n",
+             nr_failed,hits,misses,nr_threads);
+    out += line;
+    return out;
+}
+
+// Creates the listening socket; an existing socket file is only replaced if no daemon answers on it
+static int Listen(const char* path)
+{
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path,path);
+    const int fd = socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd,(struct sockaddr*) &addr,sizeof(addr)) == 0) {
+        fprintf(stderr,"Error: a daemon is already listening on %s\n",path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd,(struct sockaddr*) &addr,sizeof(addr)) != 0 || listen(fd,16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv)
+{
+    std::string socket_path = DAEMON_DEFAULT_SOCKET;
+    int nr_threads = omp_get_num_procs();
+    bool pin = true;
+    const char* tuning_profile = NULL;
+    static struct option long_options[] = {
+        {"socket",     required_argument, NULL, 's'},
+        {"nr_threads", required_argument, NULL, 'p'},
+        {"pin",        required_argument, NULL, 'n'},
+        {"profile",    required_argument, NULL, 'P'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc,argv,"h",long_options,NULL)) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'p': nr_threads = atoi(optarg); break;
+            case 'n': pin = (atoi(optarg) != 0); break;
+            case 'P': tuning_profile = optarg; break;
+            case 'h': PrintUsage(argv[0]); return 0;
+            default: PrintUsage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc || nr_threads < 1) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    const int listen_fd = Listen(socket_path.c_str());
+    if (listen_fd < 0) {
+        fprintf(stderr,"Error: cannot listen on %s\n",socket_path.c_str());
+        return 1;
+    }
+    // Without SA_RESTART, poll returns on SIGINT/SIGTERM
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_handler = RequestShutdown;
+    sigaction(SIGINT,&action,NULL);
+    sigaction(SIGTERM,&action,NULL);
+    signal(SIGPIPE,SIG_IGN);
+
+    StartThreads(nr_threads,pin);
+    Daemon daemon(nr_threads,tuning_profile);
+    fprintf(stderr,"palmsd: listening on %s with %d %s threads\n",socket_path.c_str(),nr_threads,
+            pin ? "pinned" : "unpinned");
+
+    // Requests are served one after another, each solve uses all threads
+    std::vector<struct pollfd> fds(1);
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    while (!shutdown_requested) {
+        if (poll(fds.data(),fds.size(),-1) < 0)
+            continue;
+        if (fds[0].revents & POLLIN) {
+            struct pollfd client;
+            client.fd = accept4(listen_fd,NULL,NULL,SOCK_CLOEXEC);
+            client.events = POLLIN;
+            client.revents = 0;
+            if (client.fd >= 0)
+                fds.push_back(client);
+        }
+        for(size_t k = 1; k < fds.size() && !shutdown_requested; k++) {
+            if (fds[k].revents == 0)
+                continue;
+            DaemonRequest request;
+            memset(&request,0,sizeof(request));
+            int fd;
+            const ssize_t size = (fds[k].revents & POLLIN) ? ReceiveRequest(fds[k].fd,request,fd) : 0;
+            if (size <= 0) {
+                // The client has closed the connection
+                close(fds[k].fd);
+                fds[k].fd = -1;
+                continue;
+            }
+            fds[k].revents = 0;
+            DaemonReply reply;
+            memset(&reply,0,sizeof(reply));
+            memcpy(reply.magic,"PLMD",4);
+            reply.status = PALMS_ERROR_INVALID_ARGUMENT;
+            std::string report;
+            bool send_report = false;
+            if (size == (ssize_t) sizeof(request) && memcmp(request.magic,"PLMD",4) == 0) {
+                if (request.type == DAEMON_SOLVE) {
+                    reply = daemon.solve(request,fd);
+                } else if (request.type == DAEMON_STATS) {
+                    reply.status = PALMS_OK;
+                    report = daemon.report().substr(0,DAEMON_MAX_REPORT);
+                    send_report = true;
+                } else if (request.type == DAEMON_SHUTDOWN) {
+                    reply.status = PALMS_OK;
+                    shutdown_requested = 1;
+                }
+            }
+            if (fd >= 0)
+                close(fd);
+            send(fds[k].fd,&reply,sizeof(reply),MSG_NOSIGNAL);
+            if (send_report)
+                send(fds[k].fd,report.data(),report.size(),MSG_NOSIGNAL);
+        }
+        // Drop closed connections
+        size_t nr_open = 1;
+        for(size_t k = 1; k < fds.size(); k++) {
+            if (fds[k].fd >= 0)
+                fds[nr_open++] = fds[k];
+        }
+        fds.resize(nr_open);
+    }
+    for(size_t k = 1; k < fds.size(); k++)
+        close(fds[k].fd);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    fprintf(stderr,"palmsd: shutting down\n%s",daemon.report().c_str());
+    return 0;
+}
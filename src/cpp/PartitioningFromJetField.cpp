@@ -0,0 +1,78 @@
+/**
+    PartitioningFromJetField.cpp
+    Purpose: Computes the label image of the partitioning induced by the (piecewise constant)
+             jet field a,b,c: neighboring pixels (8-neighborhood) belong to the same segment
+             if their jets coincide up to a relative tolerance (cf. getPartitioningFromJetField.m)
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include "linewiseAffineMS.h"
+
+// Root of a pixel in the union-find forest (with path halving)
+static int FindRoot(vector<int> &parent, int p)
+{
+    while (parent[p] != p) {
+        parent[p] = parent[parent[p]];
+        p = parent[p];
+    }
+    return p;
+}
+
+static bool JetsDiffer(const cube &x, const int p, const int q, const double tol)
+{
+    const uword nr_pixels = x.n_rows*x.n_cols;
+    const double* x_raw = x.memptr();
+    for(uword ch = 0; ch < x.n_slices; ch++) {
+        double x_p = x_raw[p + ch*nr_pixels];
+        double x_q = x_raw[q + ch*nr_pixels];
+        if (abs(x_p-x_q)/(abs(x_p)+abs(x_q)) > tol)
+            return true;
+    }
+    return false;
+}
+
+int PartitioningFromJetField(const cube &a, const cube &b, const cube &c, Mat<int> &partition)
+{
+    const int m = c.n_rows;
+    const int n = c.n_cols;
+    // Allowed relative difference between neighboring jet coefficients
+    const double tol = 1e-2;
+    // Neighbors (row,col offsets) of the 8-neighborhood that are visited in forward direction
+    const int di[4] = {1,0,1,-1};
+    const int dj[4] = {0,1,1,1};
+
+    vector<int> parent(m*n);
+    for(int p = 0; p < m*n; p++)
+        parent[p] = p;
+    for(int j = 0; j < n; j++) {
+        for(int i = 0; i < m; i++) {
+            const int p = i + j*m;
+            for(int d = 0; d < 4; d++) {
+                const int i_q = i + di[d];
+                const int j_q = j + dj[d];
+                if (i_q < 0 || i_q >= m || j_q >= n)
+                    continue;
+                const int q = i_q + j_q*m;
+                if (JetsDiffer(a,p,q,tol) || JetsDiffer(b,p,q,tol) || JetsDiffer(c,p,q,tol))
+                    continue;
+                // Join the segments of p and q
+                int root_p = FindRoot(parent,p);
+                int root_q = FindRoot(parent,q);
+                if (root_p != root_q)
+                    parent[max(root_p,root_q)] = min(root_p,root_q);
+            }
+        }
+    }
+    // Number the segments consecutively (1-based) in order of their first pixel
+    vector<int> label(m*n,0);
+    int nr_segments = 0;
+    for(int p = 0; p < m*n; p++) {
+        int root = FindRoot(parent,p);
+        if (label[root] == 0)
+            label[root] = ++nr_segments;
+        partition(p) = label[root];
+    }
+    return nr_segments;
+}
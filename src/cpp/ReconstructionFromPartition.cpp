@@ -29,16 +29,10 @@ void ReconstructionFromPartition(const ivec &L, mat u_data, mat a_data, mat b_da
         l = L(r-1)+1;
         // Handle/Catch interval lengths < 2
         if (r-l +1 < 2) {
+            // (the mean of the b data of an interval of length 1 is its b data)
             u_out.cols(l-1,r-1) = u_data.cols(l-1,r-1);
             a_out.cols(l-1,r-1) = a_data.cols(l-1,r-1);
-            vec b_mean(nr_channels);
-            for(int ch=0; ch < nr_channels; ch++) {
-                vec tmp = b_data(span(ch,ch) , span(l-1,r-1));
-                b_mean(ch) = mean(tmp);
-            }
-            for(int w = l; w <= r; w++ ) {
-                b_out.col(w-1) = b_mean;
-            }
+            b_out.cols(l-1,r-1) = b_data.cols(l-1,r-1);
         }
         else {
             Intervals.push_front(Interval(l,r,nr_channels,eta*u_data.cols(l-1,r-1),a_data.cols(l-1,r-1),b_data.cols(l-1,r-1)));
@@ -58,7 +52,6 @@ void ReconstructionFromPartition(const ivec &L, mat u_data, mat a_data, mat b_da
     mat p = zeros<mat>(nr_channels,3);
 
     rowvec I = linspace<vec>(1,n,n).t();
-    mat udata_curr,adata_curr;
     double c,s;
     // The master iterator knowing which intervals have to be considered (i.e. which interval lengths)
     list<Interval>::iterator master_it = Intervals.begin();
@@ -128,8 +121,8 @@ void ReconstructionFromPartition(const ivec &L, mat u_data, mat a_data, mat b_da
             }
             // Back substitution
             p.zeros();
-            udata_curr = curr.getUdata();
-            adata_curr = curr.getAdata();
+            const mat &udata_curr = curr.getUdata();
+            const mat &adata_curr = curr.getAdata();
 
             // Get linear coefficients
             for(int ch = 0; ch < nr_channels; ch++) {
@@ -138,10 +131,12 @@ void ReconstructionFromPartition(const ivec &L, mat u_data, mat a_data, mat b_da
                 p(ch,0)  = mean(curr.getBdata().row(ch)); // slope b
             }
 
-            // Fill segment channelwise
-            for(int ch=0; ch<nr_channels; ch++){
+            // Fill segment pixelwise (the channels of a pixel are contiguous)
+            for(int t = l; t <= r; t++) {
                 // compute the functional values on the interval
-                u_out(span(ch,ch),span(curr.getL()-1,curr.getR()-1)) = p(ch,1)*I.cols(0,curr.giveLength()-1)+p(ch,2);
+                double* u_t = u_out.colptr(t-1);
+                for(int ch = 0; ch < nr_channels; ch++)
+                    u_t[ch] = p(ch,1)*I(t-l)+p(ch,2);
             }
             // Save slopes
             for(int t = l; t <= r; t++) {
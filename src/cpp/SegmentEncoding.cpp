@@ -0,0 +1,164 @@
+/**
+    SegmentEncoding.cpp
+    Purpose: Encodes the piecewise affine-linear result as one record per segment
+             (affine coefficients and run-length encoded pixel set) and rasterizes
+             such a stream back to the dense u and the partition
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <cstring>
+#include <vector>
+#include "SegmentEncoding.h"
+
+bool EncodeSegments(const Mat<int> &partition, const cube &a, const cube &b, const cube &c,
+                    SegmentWriter write, void* user)
+{
+    const uword m = partition.n_rows;
+    const uword n = partition.n_cols;
+    const uword nr_pixels = m*n;
+    const uword nr_channels = a.n_slices;
+    const int* labels = partition.memptr();
+
+    int nr_segments = 0;
+    for(uword p = 0; p < nr_pixels; p++) {
+        if (labels[p] < 1)
+            return false;
+        nr_segments = std::max(nr_segments,labels[p]);
+    }
+    // Every label up to the max one has to be used (the mean of an empty segment is undefined)
+    std::vector<bool> used(nr_segments+1,false);
+    for(uword p = 0; p < nr_pixels; p++)
+        used[labels[p]] = true;
+    for(int k = 1; k <= nr_segments; k++) {
+        if (!used[k])
+            return false;
+    }
+    // Runs are maximal ranges of consecutive linear indices with the same label
+    std::vector<uint32_t> run_count(nr_segments+1,0);
+    for(uword p = 0; p < nr_pixels; p++) {
+        if (p == 0 || labels[p] != labels[p-1])
+            run_count[labels[p]]++;
+    }
+    std::vector<uword> run_offset(nr_segments+2,0);
+    for(int k = 1; k <= nr_segments; k++)
+        run_offset[k+1] = run_offset[k] + run_count[k];
+    std::vector<uint32_t> runs(2*run_offset[nr_segments+1]);
+    std::vector<uword> next_run(run_offset.begin(),run_offset.end()-1);
+    // Accumulate the jets of each segment for averaging
+    std::vector<double> coefficients((nr_segments+1)*3*nr_channels,0.0);
+    std::vector<uword> nr_segment_pixels(nr_segments+1,0);
+    for(uword p = 0; p < nr_pixels; p++) {
+        const int k = labels[p];
+        if (p == 0 || k != labels[p-1]) {
+            uword r = next_run[k]++;
+            runs[2*r] = p;
+            runs[2*r+1] = 0;
+        }
+        runs[2*(next_run[k]-1)+1]++;
+        nr_segment_pixels[k]++;
+        double* coeff = &coefficients[k*3*nr_channels];
+        for(uword ch = 0; ch < nr_channels; ch++) {
+            coeff[ch] += a(p + ch*nr_pixels);
+            coeff[nr_channels + ch] += b(p + ch*nr_pixels);
+            coeff[2*nr_channels + ch] += c(p + ch*nr_pixels);
+        }
+    }
+
+    SegmentFileHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,"PLSG",4);
+    header.version = 1;
+    header.m = m;
+    header.n = n;
+    header.nr_channels = nr_channels;
+    header.nr_segments = nr_segments;
+    if (write(&header,sizeof(header),user) != 0)
+        return false;
+    // Emit one self-contained record per segment
+    for(int k = 1; k <= nr_segments; k++) {
+        SegmentRecordHeader record;
+        record.label = k;
+        record.nr_runs = run_count[k];
+        double* coeff = &coefficients[k*3*nr_channels];
+        for(uword i = 0; i < 3*nr_channels; i++)
+            coeff[i] /= nr_segment_pixels[k];
+        if (write(&record,sizeof(record),user) != 0 ||
+            write(coeff,3*nr_channels*sizeof(double),user) != 0 ||
+            write(&runs[2*run_offset[k]],2*run_count[k]*sizeof(uint32_t),user) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool ReadSegmentHeader(const unsigned char* data, size_t size, SegmentFileHeader &header)
+{
+    if (size < sizeof(SegmentFileHeader))
+        return false;
+    memcpy(&header,data,sizeof(header));
+    return memcmp(header.magic,"PLSG",4) == 0 && header.version == 1;
+}
+
+bool RasterizeSegments(const unsigned char* data, size_t size, double* u, int* partition)
+{
+    SegmentFileHeader header;
+    if (!ReadSegmentHeader(data,size,header))
+        return false;
+    const uword m = header.m;
+    const uword nr_pixels = (uword) header.m*header.n;
+    const uword nr_channels = header.nr_channels;
+    const unsigned char* p = data + sizeof(header);
+    const unsigned char* end = data + size;
+    std::vector<double> coeff(3*nr_channels);
+
+    for(uint32_t k = 0; k < header.nr_segments; k++) {
+        SegmentRecordHeader record;
+        if ((size_t)(end-p) < sizeof(record))
+            return false;
+        memcpy(&record,p,sizeof(record));
+        p += sizeof(record);
+        if (record.nr_runs == 0 || record.label < 1 || record.label > header.nr_segments)
+            return false;
+        const size_t record_size = 3*nr_channels*sizeof(double) + 2*sizeof(uint32_t)*(size_t) record.nr_runs;
+        if ((size_t)(end-p) < record_size)
+            return false;
+        memcpy(coeff.data(),p,3*nr_channels*sizeof(double));
+        p += 3*nr_channels*sizeof(double);
+        const double* a = &coeff[0];
+        const double* b = &coeff[nr_channels];
+        const double* c = &coeff[2*nr_channels];
+
+        for(uint32_t r = 0; r < record.nr_runs; r++) {
+            uint32_t run[2];
+            memcpy(run,p,sizeof(run));
+            p += sizeof(run);
+            const uword start = run[0];
+            const uword length = run[1];
+            if (start + length > nr_pixels)
+                return false;
+            if (partition != NULL) {
+                for(uword q = start; q < start+length; q++)
+                    partition[q] = record.label;
+            }
+            if (u == NULL)
+                continue;
+            // Along a run, the row index increases by one and wraps to the next column
+            for(uword ch = 0; ch < nr_channels; ch++) {
+                double* u_ch = u + ch*nr_pixels;
+                uword i = start % m;
+                uword j = start / m;
+                double column_offset = c[ch] + (j+1)*a[ch];
+                for(uword q = start; q < start+length; q++) {
+                    u_ch[q] = column_offset + (i+1)*b[ch];
+                    if (++i == m) {
+                        i = 0;
+                        j++;
+                        column_offset = c[ch] + (j+1)*a[ch];
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
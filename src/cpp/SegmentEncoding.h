@@ -0,0 +1,46 @@
+#ifndef SEGMENTENCODING_H
+#define SEGMENTENCODING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#define ARMA_NO_DEBUG
+#include <armadillo>
+
+using namespace arma;
+
+// Compact segment-based result format (native byte order):
+//   SegmentFileHeader, followed by one record per segment:
+//   SegmentRecordHeader, double coefficients[3*nr_channels] (a, b, c of all channels),
+//   nr_runs pairs (uint32 start, uint32 length) of column-major linear pixel indices
+// Records are self-contained, so the format can be written and read as a stream.
+struct SegmentFileHeader {
+    char magic[4];          // "PLSG"
+    uint32_t version;
+    uint32_t m;
+    uint32_t n;
+    uint32_t nr_channels;
+    uint32_t nr_segments;
+    uint32_t reserved[2];
+};
+struct SegmentRecordHeader {
+    uint32_t label;         // 1-based label of the segment in the partition
+    uint32_t nr_runs;
+};
+
+// Sink for the encoded stream; returns 0 on success
+typedef int (*SegmentWriter)(const void* data, size_t size, void* user);
+
+// Encodes the partition and the (segmentwise averaged) jets a,b,c as one record per segment (lossy: the jets of
+// a segment agree up to the tolerance of PartitioningFromJetField); returns false if a label is not positive or
+// a label up to the max one has no pixels
+bool EncodeSegments(const Mat<int> &partition, const cube &a, const cube &b, const cube &c,
+                    SegmentWriter write, void* user);
+
+// Reads the header of an encoded stream
+bool ReadSegmentHeader(const unsigned char* data, size_t size, SegmentFileHeader &header);
+
+// Rebuilds the dense u = c + j*a + i*b and the partition (each may be NULL) from an encoded stream; returns
+// false if the stream is truncated, a run is out of the image, or a record has no runs or a label out of range
+bool RasterizeSegments(const unsigned char* data, size_t size, double* u, int* partition);
+
+#endif
@@ -0,0 +1,128 @@
+/**
+    SolverCache.cpp
+    Purpose: Keeps Givens tables, stripe plans, state workspaces and scratch buffers across solves, so that repeated
+             solves of the same image shape (e.g. by the solver daemon) skip their setup
+
+    @author Lukas Kiefer
+    @version 1.0
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include "SolverCache.h"
+
+void CreateDirectionPlans(const int m, const int n, const int nr_channels, const ADMMParameters &par,
+                          DirectionPlans &plans)
+{
+    imat dirs;
+    vec omegas;
+    GetDirsAndWeights(par.nr_dirs,dirs,omegas);
+    // Thread count, schedule and layout of each direction (tuned for the shape if in the profile)
+    TunedConfigs(m,n,nr_channels,par,plans.configs);
+    // Stripes and their memory layout for each direction
+    const uword long_stripe_length = LongStripeLength(par,m,n);
+    plans.plans.assign(par.nr_dirs,StripePlan());
+    for(int s = 0; s < par.nr_dirs; s++) {
+        vec dir_s(2);
+        dir_s(0) = dirs(0,s);
+        dir_s(1) = dirs(1,s);
+        CreateStripePlan(dir_s,m,n,plans.configs[s].packed_layout,long_stripe_length,plans.plans[s]);
+    }
+}
+
+// Getter
+size_t SolverCache::getHits() const{
+    return tables.hits + plans.hits + workspaces.hits + scratch.hits;
+}
+size_t SolverCache::getMisses() const{
+    return tables.misses + plans.misses + workspaces.misses + scratch.misses;
+}
+
+// Constructor
+SolverCache::SolverCache(const size_t max_tables, const size_t max_plans, const size_t max_workspaces)
+{
+    tables.capacity = max_tables;
+    plans.capacity = max_plans;
+    workspaces.capacity = max_workspaces;
+    scratch.capacity = max_workspaces;
+    tables.hits = tables.misses = 0;
+    plans.hits = plans.misses = 0;
+    workspaces.hits = workspaces.misses = 0;
+    scratch.hits = scratch.misses = 0;
+}
+
+// Returns the entry of key (marked as most recently used) or NULL
+template <typename T> T* SolverCache::find(Entries<T> &entries, const std::string &key)
+{
+    typename std::map<std::string,T>::iterator it = entries.values.find(key);
+    if (it == entries.values.end()) {
+        entries.misses++;
+        return NULL;
+    }
+    entries.hits++;
+    entries.order.remove(key);
+    entries.order.push_front(key);
+    return &it->second;
+}
+
+// Adds an empty entry for key and drops the least recently used ones beyond the capacity
+template <typename T> T &SolverCache::insert(Entries<T> &entries, const std::string &key)
+{
+    while (!entries.order.empty() && entries.order.size() >= max(entries.capacity,(size_t) 1)) {
+        entries.values.erase(entries.order.back());
+        entries.order.pop_back();
+    }
+    entries.order.push_front(key);
+    return entries.values[key];
+}
+
+GivensTable &SolverCache::givensAngles(const int max_length, const double eta)
+{
+    // The data weight is part of the key with all its bits
+    char key[64];
+    snprintf(key,sizeof(key),"%d %a",max_length,eta);
+    GivensTable* table = find(tables,key);
+    if (table == NULL) {
+        table = &insert(tables,key);
+        CalcGivensAngles(max_length,eta,table->C_linear,table->S_linear,table->C_const,table->S_const);
+    }
+    return *table;
+}
+
+const DirectionPlans &SolverCache::directionPlans(const int m, const int n, const int nr_channels,
+                                                  const ADMMParameters &par)
+{
+    // Everything the configurations and plans depend on
+    char key[64];
+    snprintf(key,sizeof(key),"%d %d %d %d %d %d %d ",m,n,nr_channels,par.nr_dirs,par.nr_threads,
+             (int) par.packed_layout,par.long_stripe_length);
+    // A profile that changed since (e.g. by an autotuner in another process) gives new plans
+    const std::string plans_key = std::string(key) + (par.tuning_profile != NULL ?
+        std::string(par.tuning_profile) + " " + TuningProfile::fileVersion(par.tuning_profile) : "");
+    DirectionPlans* entry = find(plans,plans_key);
+    if (entry == NULL) {
+        entry = &insert(plans,plans_key);
+        CreateDirectionPlans(m,n,nr_channels,par,*entry);
+    }
+    return *entry;
+}
+
+ADMMState &SolverCache::workspace(const int m, const int n, const int nr_channels, const int nr_dirs)
+{
+    char key[64];
+    snprintf(key,sizeof(key),"%d %d %d %d",m,n,nr_channels,nr_dirs);
+    ADMMState* state = find(workspaces,key);
+    if (state == NULL)
+        state = &insert(workspaces,key);
+    return *state;
+}
+
+ScratchBuffers &SolverCache::scratchBuffers(const int m, const int n, const int nr_channels, const int nr_dirs)
+{
+    char key[64];
+    snprintf(key,sizeof(key),"%d %d %d %d",m,n,nr_channels,nr_dirs);
+    ScratchBuffers* buffers = find(scratch,key);
+    if (buffers == NULL)
+        buffers = &insert(scratch,key);
+    return *buffers;
+}
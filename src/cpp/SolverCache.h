@@ -0,0 +1,74 @@
+#ifndef SOLVERCACHE_H
+#define SOLVERCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include "linewiseAffineMS.h"
+#include "Autotuner.h"
+
+// Givens rotation angles of the univariate subproblems for stripes up to a max length and a data weight
+struct GivensTable {
+    mat C_linear, S_linear, C_const, S_const;
+};
+
+// Configurations and stripe plans of all directions for an image shape
+struct DirectionPlans {
+    vector<DirectionConfig> configs;
+    vector<StripePlan> plans;
+};
+
+// Scratch buffers of a solve: packed copies of the subproblem data (one per direction for the Jacobi variant)
+// and the next iterate of the Jacobi variant
+struct ScratchBuffers {
+    vector<PackedData> packed;
+    vector<cube> us_next, as_next, bs_next;
+};
+
+// Thread count, schedule and layout (see TunedConfigs) and stripe plan of each direction for an
+// m x n x nr_channels image
+void CreateDirectionPlans(const int m, const int n, const int nr_channels, const ADMMParameters &par,
+                          DirectionPlans &plans);
+
+// Keeps the setup of solves across requests: Givens tables by (max stripe length, data weight), direction plans
+// by image shape and configuration, and ADMM state workspaces and scratch buffers by image shape (reused without
+// reallocation).
+// The least recently used entries are dropped when a capacity is exceeded. With the fixed progression of the
+// coupling penalties, solves with the same gamma run through the same data weights (one per iteration), so
+// repeated solves of a shape take their tables from the cache if they need at most max_tables iterations;
+// a longer solve drops its own first tables before it reaches them again and computes all of them (as do
+// solves with the adaptive progression, whose data weights vary). A cache must not be used by concurrent solves.
+class SolverCache
+{
+private:
+    template <typename T> struct Entries {
+        std::map<std::string,T> values;
+        std::list<std::string> order;       // Keys from most to least recently used
+        size_t capacity;
+        size_t hits, misses;
+    };
+    Entries<GivensTable> tables;
+    Entries<DirectionPlans> plans;
+    Entries<ADMMState> workspaces;
+    Entries<ScratchBuffers> scratch;
+    template <typename T> static T* find(Entries<T> &entries, const std::string &key);
+    template <typename T> static T &insert(Entries<T> &entries, const std::string &key);
+public:
+    // Getter
+    size_t getHits() const;
+    size_t getMisses() const;
+    // Constructor (max number of Givens tables, direction plans and state workspaces; as many scratch buffers
+    // as workspaces are kept)
+    SolverCache(const size_t max_tables = 256, const size_t max_plans = 16, const size_t max_workspaces = 2);
+    // Givens rotation angles for stripes up to max_length and data weight eta (computed on first use); the
+    // reference stays valid until the next call
+    GivensTable &givensAngles(const int max_length, const double eta);
+    // Configurations and stripe plans of all directions for the shape and the parameters (created on first use)
+    const DirectionPlans &directionPlans(const int m, const int n, const int nr_channels, const ADMMParameters &par);
+    // State workspace of the shape (to be initialized by InitADMMState, which reuses its memory)
+    ADMMState &workspace(const int m, const int n, const int nr_channels, const int nr_dirs);
+    // Scratch buffers of the shape (sized by the solve, which reuses their memory)
+    ScratchBuffers &scratchBuffers(const int m, const int n, const int nr_channels, const int nr_dirs);
+};
+
+#endif
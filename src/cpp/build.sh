@@ -0,0 +1,17 @@
+#!/bin/sh
+# Build the standalone library libpalms.so (C API: PalmsAPI.h), the command-line tool palms and
+# the solver daemon palmsd with its stand-in client palms_client (Linux)
+# Requires the Armadillo and OpenMP library (see build.m for the MATLAB mex build)
+cd "$(dirname "$0")"
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-O3 -march=native"}
+SOURCES="ArmadilloConverter.cpp Compute1rErrors.cpp Extract1Dstripes.cpp FindBest1DPartition.cpp FindBest1DPartitionParallel.cpp GenerateSystemMatrices.cpp
+         GetIndexes.cpp Interval.cpp LinewisePartitioning.cpp ReconstructionFromPartition.cpp Stripe.cpp
+         AffineLinearADMM.cpp CalcGivensAngles.cpp GetDirsAndWeights.cpp FusedLinewiseSolver.cpp
+         LinewiseSolver.cpp PartitioningFromJetField.cpp IncrementalADMM.cpp Autotuner.cpp Checkpoint.cpp SegmentEncoding.cpp
+         ChannelCompression.cpp SolverCache.cpp PalmsAPI.cpp"
+$CXX $CXXFLAGS -fopenmp -pthread -fPIC -shared -o libpalms.so $SOURCES -larmadillo || exit 1
+# The tool is linked statically against the sources to keep process startup short
+$CXX $CXXFLAGS -fopenmp -pthread -o palms PalmsCLI.cpp ImageIO.cpp $SOURCES -larmadillo || exit 1
+$CXX $CXXFLAGS -fopenmp -pthread -o palmsd PalmsDaemon.cpp LatencyHistogram.cpp $SOURCES -larmadillo || exit 1
+$CXX $CXXFLAGS -fopenmp -pthread -o palms_client PalmsClient.cpp ImageIO.cpp LatencyHistogram.cpp $SOURCES -larmadillo
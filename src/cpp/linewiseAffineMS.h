@@ -13,6 +13,75 @@
 using namespace std;
 using namespace arma;
 
+class SolverCache;
+
+// Parameters of the ADMM scheme (cf. affineLinearPartitioning.m)
+struct ADMMParameters {
+    double gamma;       // Boundary penalty
+    int nr_dirs;        // 2: anisotropic, 4: near-isotropic discretization
+    int max_iter;       // Max number of ADMM iterations
+    double mu_nu_step;  // Progression of the coupling penalties mu,nu
+    double split_tol;   // Relative difference stopping criterion
+    int nr_threads;     // Number of OpenMP threads
+    bool verbose;       // Print iterations and total number of iterations
+    bool packed_layout; // Solve non-contiguous (diagonal/horizontal) stripes on a sheared/transposed copy
+    double time_budget; // Time budget of a solve in seconds (<= 0: unlimited)
+    const volatile int* cancel; // The solve is cut short as soon as *cancel != 0 (may be NULL)
+    bool jacobi;        // Solve all directions concurrently from the previous iterate (instead of Gauss-Seidel)
+    int long_stripe_length; // Min length of stripes solved one after another with the parallel DP (<= 0: never);
+                            // only stripes longer than an equal share of the pixels per thread are affected
+    const char* tuning_profile; // Profile with thread count, schedule and layout per shape and direction
+                                // (NULL: nr_threads, dynamic schedule and packed_layout for all directions);
+                                // with jacobi, only the layouts are used (one pool for all directions)
+    bool adaptive_penalties;    // Choose the progression of mu,nu from the coupling residual and the change of the
+                                // 1D partitions: min(mu_nu_step,1.5) while they form, then at least mu_nu_step
+                                // (false: fixed progression mu_nu_step)
+    const char* checkpoint_path;    // File of the periodic checkpoints of the state (NULL: none)
+    int checkpoint_interval;        // Number of iterations between checkpoints
+    bool checkpoint_float32;        // Store the checkpoints in single precision (compact, resume is not bit-exact)
+    bool compress_channels;         // Solve on the coordinates of f w.r.t. an orthonormal basis of its channel span
+    SolverCache* cache;             // Givens tables, stripe plans and workspaces kept across solves (NULL: none)
+    ADMMParameters();
+};
+
+// Cooperative cancellation of a solve, checked between stripes and directions
+struct Cancellation {
+    double deadline;            // omp_get_wtime() at which the solve is cut short (<= 0: none)
+    const volatile int* flag;   // External cancellation flag (may be NULL)
+    bool requested() const;
+};
+
+// State of the ADMM scheme, i.e., splitting variables, Lagrange multipliers and coupling penalties
+struct ADMMState {
+    int nr_dirs;
+    vector<cube> us, as, bs;                // Splitting variables of each direction
+    vector<cube> lambdas, taus, rhos;       // Multipliers of each pair s < t (see PairIndex)
+    double mu, nu;                          // Coupling penalties
+    vector<double> mus, nus;                // Coupling penalties of each performed iteration (empty or
+                                            // shorter if the state was not solved from the start)
+    int iteration;                          // Number of performed iterations
+    bool truncated;                         // Last solve was cut short by its deadline or cancellation
+    double deviation;                       // Splitting deviation of the last iteration (-1: none)
+    double penalty_step;                    // Progression of the coupling penalties of the last iteration
+    vector< Mat<unsigned char> > jumps;     // Jump indicators of the 1D partitions (adaptive schedule)
+};
+
+// Memory layout of the stripes of one direction. In the packed layout, the stripes are stored one
+// after another with interleaved channels (a sheared copy for diagonal and a transposed copy for
+// horizontal directions), so that each stripe is contiguous in memory.
+struct StripePlan {
+    vector<uvec> stripes;   // Linear indices (w.r.t. a single channel) of each stripe
+    uvec offsets;           // First packed column of each stripe, followed by the number of pixels
+    uvec positions;         // Packed column of each pixel (empty if the stripes are gathered in place)
+    uword long_stripe_length; // Stripes of at least this length are solved with the parallel DP (0: none)
+};
+
+// Packed copies (nr_channels x m*n) of the subproblem data of a direction with packed layout; allocated on
+// first use and reused by the following direction solves
+struct PackedData {
+    mat u, x, y;
+};
+
 // Converter from pointers to armadillo objects
 void ArmadilloConverter(double* u_data_raw, double* a_data_raw,double* b_data_raw,
                         double* C_linear_raw,double* S_linear_raw,
@@ -30,9 +99,26 @@ void LinewisePartitioning(cube &u_out,cube &a_out,cube &b_out,
 // Extracts and stores the stripes of the input image
 void Extract1Dstripes(const cube &I, const vec &dir,std::vector<Stripe>  &L, const int m, const int n,const int nr_channels);
 
+// Extracts the linear indices (w.r.t. a single channel) of all stripes for direction dir
+void ExtractStripeIndices(const vec &dir, std::vector<uvec> &L, const int m, const int n);
+
+// Creates the stripes of direction dir and, if packed is set and the stripes are not
+// contiguous in the column-major image, the pixel positions of the packed layout
+// Stripes of at least long_stripe_length (0: none) are solved with the parallel DP
+void CreateStripePlan(const vec &dir, const int m, const int n, const bool packed, const uword long_stripe_length,
+                      StripePlan &plan);
+
+// Min length of the stripes solved with the parallel DP for an image of size m x n (0: none)
+uword LongStripeLength(const ADMMParameters &par, const int m, const int n);
+
 // Extracts linear indices of a line of the image domain
 uvec GetIndexes(int x_lim,int x_cor,int x_dir,int y_lim,int y_cor,int y_dir);
 
+// Solves the univariate partitioning problem of a single stripe (with the parallel DP if parallel_dp is set)
+void Solve1DProblem(const mat &u_data, const mat &a_data, const mat &b_data, const int nr_channels,
+                    double gamma_s, double eta_s, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                    mat &u_out, mat &a_out, mat &b_out, const bool parallel_dp = false);
+
 // Generates the "regression"-matrices for alpha,delta in eq. (27) in the affine-linear 1D-jet estimation 
 void GenerateSystemMatrices(const int n,double eta, mat &A);
 
@@ -45,10 +131,92 @@ void FindBest1DPartition(mat u_data,mat a_data,mat b_data,const int n, const int
                          double eta, const vec &eps_1r, mat &C_linear, mat &S_linear,
                          mat &C_const, mat &S_const, ivec &L);
 
+// Computes the same partitioning as FindBest1DPartition, scanning long candidate lists in parallel (for long stripes)
+void FindBest1DPartitionParallel(mat u_data,mat a_data,mat b_data,const int n, const int nr_channels, double &gamma,
+                                 double eta, const vec &eps_1r, mat &C_linear, mat &S_linear,
+                                 mat &C_const, mat &S_const, ivec &L);
+
 // Computes the corresponding reconstruction for an optimal partition
 void ReconstructionFromPartition(const ivec &L, mat u_data, mat a_data, mat b_data, const int n,
                                  const int nr_channels, double eta,
                                  const mat &C_linear, const mat &S_linear,
                                  mat &u_out, mat &a_out, mat &b_out);
 
+// Returns the directions (x_dir,y_dir) of the discrete gradient as columns and their weights
+void GetDirsAndWeights(const int nr_dirs, imat &dirs, vec &omegas);
+
+// Computes the recurrence coefficients (Givens rotation angles) of the univariate subproblems
+void CalcGivensAngles(const int n, const double eta, mat &C_linear, mat &S_linear, mat &C_const, mat &S_const);
+
+// Solves the univariate subproblems of the s-th direction of the ADMM scheme; the subproblem data
+// is gathered stripewise from f, the splitting variables and multipliers (no intermediate cubes)
+// The stripes are distributed by the run-time schedule (omp_set_schedule)
+// packed holds the packed copies if the plan has a packed layout
+// Returns false if the solve was cancelled; then the remaining stripes keep their previous solutions
+bool FusedLinewiseSolver(const cube &f, ADMMState &state, const int s, const StripePlan &plan,
+                         double gamma_s, double eta_s,
+                         mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                         PackedData &packed, const Cancellation *cancel = NULL);
+
+// Jacobi variant: solves the univariate subproblems of all directions in one pool of stripes (current thread
+// count, dynamic schedule); the subproblem data is built from state and the solutions are written to us_next,
+// as_next, bs_next.
+// packed holds the packed copies of each direction (nr_dirs entries)
+// Returns false if the solve was cancelled; then the next iterate is incomplete
+bool FusedJacobiSolver(const cube &f, const ADMMState &state, const vector<StripePlan> &plans,
+                       const vec &gammas, double eta_s,
+                       mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                       vector<cube> &us_next, vector<cube> &as_next, vector<cube> &bs_next,
+                       vector<PackedData> &packed,
+                       const Cancellation *cancel = NULL);
+
+// Reference for FusedLinewiseSolver: solves the univariate subproblems of the s-th direction from state with
+// the subproblem data assembled as full cubes (the native path before the fused assembly); writes the
+// solutions to u_s, a_s, b_s
+void LinewiseSolver(const cube &f, const ADMMState &state, const int s, double gamma_s, double eta_s,
+                    mat &C_linear, mat &S_linear, mat &C_const, mat &S_const,
+                    cube &u_s, cube &a_s, cube &b_s);
+
+// Max absolute deviation of the solutions of FusedLinewiseSolver from those of LinewiseSolver over all
+// directions, each solved from state (used by palms --verify)
+double FusedSolverDeviation(const cube &f, const ADMMState &state, const double gamma);
+
+// Index of the multiplier of the direction pair s < t (0-based) in the upper triangle storage
+int PairIndex(const int s, const int t, const int nr_dirs);
+
+// Initializes the ADMM state with u_0 = f, a_0 = b_0 = 0 and zero multipliers (reusing the memory of a state
+// of the same size)
+void InitADMMState(ADMMState &state, const cube &f, const int nr_dirs);
+
+// Performs the ADMM strategy for the piecewise affine-linear Mumford-Shah model and returns the number of iterations
+// With a time budget, the progression of the coupling penalties is increased if the projected time exceeds
+// the budget; if the budget runs out or the solve is cancelled, the current consensus is returned and
+// state.truncated is set
+int AffineLinearADMM(const cube &f, const ADMMParameters &par, ADMMState &state,
+                     cube &u, cube &a, cube &b, cube &c);
+
+// Computes the consensus u,a,b (means of the splitting variables) and the offsets c = u - x*a - y*b
+void ConsensusJetField(const ADMMState &state, cube &u, cube &a, cube &b, cube &c);
+
+// Re-solves the partitioning after f has been edited in the pixels marked in dirty (m x n), warm-started
+// from the cached state of a previous solve; only the stripes within a window around the dirty region are
+// solved and the window grows until the solution on its border agrees with the cached one. The work is
+// capped at that of the cached solve (the full image is solved once the windows have used their share).
+// Returns the number of iterations
+int IncrementalADMM(const cube &f, const Mat<unsigned char> &dirty, const ADMMParameters &par, ADMMState &state,
+                    cube &u, cube &a, cube &b, cube &c);
+
+// Computes the label image of the partitioning induced by the (piecewise constant) jet field a,b,c
+int PartitioningFromJetField(const cube &a, const cube &b, const cube &c, Mat<int> &partition);
+
+// Orthonormal basis (nr_channels x rank, descending energy) of the span of the channel vectors of f
+// (empty if the eigendecomposition fails)
+mat ChannelBasis(const cube &f);
+
+// Coordinates of the channel vectors of x w.r.t. the orthonormal basis
+void CompressChannels(const cube &x, const mat &basis, cube &x_compressed);
+
+// Channel vectors of x from their coordinates w.r.t. the orthonormal basis (x has to be allocated)
+void ExpandChannels(const cube &x_compressed, const mat &basis, cube &x);
+
 #endif  
\ No newline at end of file